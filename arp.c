@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: MPL-2.0 OR GPL-2.0+
+#ifdef __INTELLISENSE__
+#include <clib/exec_protos.h>
+#else
+#include <proto/exec.h>
+#endif
+
+#include <device.h>
+#include <arp.h>
+#include <compat.h>
+#include <debug.h>
+
+#define ARP_LEN 28        /* Ethernet/IPv4 ARP packet */
+#define ARP_FRAME_LEN 60  /* Reply padded to the minimum frame, the MAC appends the FCS */
+#define ARP_OP_REQUEST 1
+#define ARP_OP_REPLY 2
+
+/* Ethernet hardware, IPv4 protocol, 6 and 4 byte addresses */
+static inline BOOL ArpIsEthernetIPv4(const UBYTE *arp)
+{
+    return *(UWORD *)&arp[0] == 1 && *(UWORD *)&arp[2] == 0x0800 && arp[4] == 6 && arp[5] == 4;
+}
+
+static BOOL ArpIsOurs(struct ArpOffload *a, ULONG ip)
+{
+    for (UWORD i = 0; i < a->count; i++)
+        if (a->addr[i] == ip)
+            return TRUE;
+    return FALSE;
+}
+
+/* Unit task. Replaces the whole table, learned entries included. */
+int ArpSet(struct GenetUnit *unit, const ULONG *addrs, ULONG count)
+{
+    struct ArpOffload *a = &unit->arp;
+
+    if (count > GENET_ARP_MAX || (count && addrs == NULL))
+        return S2ERR_BAD_ARGUMENT;
+
+    ObtainSemaphore(&unit->tx_ring.tx_ring_sem);
+    for (UWORD i = 0; i < GENET_ARP_MAX; i++)
+    {
+        a->addr[i] = i < count ? addrs[i] : 0;
+        a->ttl[i] = i < count ? ARP_TTL_SET : 0;
+    }
+    a->count = count;
+    bcmgenet_tx_ring_release(unit);
+
+    Kprintf("[genet] %s: Answering ARP for %ld addresses\n", __func__, count);
+    return S2ERR_NO_ERROR;
+}
+
+/* Called with tx_ring_sem held for every ARP packet the stack sends untagged */
+void ArpLearn(struct GenetUnit *unit, const UBYTE *arp, ULONG length)
+{
+    struct ArpOffload *a = &unit->arp;
+
+    if (length < ARP_LEN || !ArpIsEthernetIPv4(arp))
+        return;
+
+    /* Sender addresses are ours unless the stack proxies for someone, probes carry 0.0.0.0 */
+    ULONG ip = *(ULONG *)&arp[14];
+    if (ip == 0 || *(ULONG *)&arp[8] != *(ULONG *)&unit->currentMacAddress[0] ||
+        *(UWORD *)&arp[12] != *(UWORD *)&unit->currentMacAddress[4])
+        return;
+
+    WORD slot = -1;
+    for (UWORD i = 0; i < GENET_ARP_MAX; i++)
+    {
+        if (i < a->count && a->addr[i] == ip)
+        {
+            if (a->ttl[i] != ARP_TTL_SET)
+                a->ttl[i] = ARP_LEARNED_SECONDS;
+            return;
+        }
+        /* Expired entries are freed by ArpExpire, set ones are never replaced */
+        if (slot < 0 && (i >= a->count || a->addr[i] == 0))
+            slot = i;
+    }
+    if (slot < 0)
+        return;
+
+    Kprintf("[genet] %s: Learned %ld.%ld.%ld.%ld\n", __func__, ip >> 24, (ip >> 16) & 0xff, (ip >> 8) & 0xff, ip & 0xff);
+    a->ttl[slot] = ARP_LEARNED_SECONDS;
+    __atomic_store_n(&a->addr[slot], ip, __ATOMIC_RELEASE);
+    if (slot >= a->count)
+        a->count = slot + 1;
+}
+
+/* Unit task, from the statistics timer. Counts learned entries down and frees the ones that ran out. */
+void ArpExpire(struct GenetUnit *unit, UWORD seconds)
+{
+    struct ArpOffload *a = &unit->arp;
+
+    if (a->count == 0)
+        return;
+
+    ObtainSemaphore(&unit->tx_ring.tx_ring_sem);
+    for (UWORD i = 0; i < a->count; i++)
+    {
+        if (a->addr[i] == 0 || a->ttl[i] == ARP_TTL_SET)
+            continue;
+        if (a->ttl[i] > seconds)
+        {
+            a->ttl[i] -= seconds;
+            continue;
+        }
+        ULONG ip = a->addr[i];
+        Kprintf("[genet] %s: Forgot %ld.%ld.%ld.%ld\n", __func__, ip >> 24, (ip >> 16) & 0xff, (ip >> 8) & 0xff, ip & 0xff);
+        __atomic_store_n(&a->addr[i], 0, __ATOMIC_RELEASE);
+        a->ttl[i] = 0;
+    }
+    bcmgenet_tx_ring_release(unit);
+}
+
+/* Unit task, untagged ARP frames only. TRUE if the frame was a request for us and the reply went out. */
+BOOL ArpAnswer(struct GenetUnit *unit, const UBYTE *packet, ULONG length)
+{
+    const UBYTE *arp = &packet[ETH_HLEN];
+
+    if (length < ETH_HLEN + ARP_LEN || !ArpIsEthernetIPv4(arp) || *(UWORD *)&arp[6] != ARP_OP_REQUEST)
+        return FALSE;
+
+    /* Gratuitous ARP for our own address means a conflict, the stack has to see that */
+    ULONG sender = *(ULONG *)&arp[14];
+    ULONG target = *(ULONG *)&arp[24];
+    if (sender == target || !ArpIsOurs(&unit->arp, target))
+        return FALSE;
+
+    UBYTE reply[ARP_FRAME_LEN];
+    UBYTE *r = &reply[ETH_HLEN];
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wstrict-aliasing"
+    /* Ethernet header, to the requester's hardware address */
+    *(ULONG *)&reply[0] = *(ULONG *)&arp[8];
+    *(UWORD *)&reply[4] = *(UWORD *)&arp[12];
+    *(ULONG *)&reply[6] = *(ULONG *)&unit->currentMacAddress[0];
+    *(UWORD *)&reply[10] = *(UWORD *)&unit->currentMacAddress[4];
+    *(UWORD *)&reply[12] = 0x0806;
+
+    *(ULONG *)&r[0] = *(ULONG *)&arp[0];
+    *(UWORD *)&r[4] = *(UWORD *)&arp[4];
+    *(UWORD *)&r[6] = ARP_OP_REPLY;
+    *(ULONG *)&r[8] = *(ULONG *)&unit->currentMacAddress[0];
+    *(UWORD *)&r[12] = *(UWORD *)&unit->currentMacAddress[4];
+    *(ULONG *)&r[14] = target;
+    *(ULONG *)&r[18] = *(ULONG *)&arp[8];
+    *(UWORD *)&r[22] = *(UWORD *)&arp[12];
+    *(ULONG *)&r[24] = sender;
+#pragma GCC diagnostic pop
+    for (ULONG i = ETH_HLEN + ARP_LEN; i < ARP_FRAME_LEN; i++)
+        reply[i] = 0;
+
+    /* Ring full: let the stack answer, it has a queue */
+    if (bcmgenet_xmit_frame(unit, reply, ARP_FRAME_LEN) != S2ERR_NO_ERROR)
+        return FALSE;
+
+    unit->internalStats.rx_arp_answered++;
+    return TRUE;
+}
@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: MPL-2.0 OR GPL-2.0+
+#ifdef __INTELLISENSE__
+#include <clib/exec_protos.h>
+#else
+#include <proto/exec.h>
+#endif
+
+#include <stddef.h>
+
+#include <device.h>
+#include <capture.h>
+#include <debug.h>
+
+#define PCAP_MAGIC 0xa1b2c3d4
+#define PCAP_LINKTYPE_ETHERNET 1
+
+struct PcapHeader
+{
+    ULONG magic;
+    UWORD versionMajor;
+    UWORD versionMinor;
+    LONG thisZone;
+    ULONG sigFigs;
+    ULONG snapLen;
+    ULONG linkType;
+};
+
+struct PcapRecord
+{
+    ULONG seconds;
+    ULONG microseconds;
+    ULONG capturedLength;
+    ULONG length;
+};
+
+/* Called by the unit task. Writers on the TX path run under the TX ring lock, which keeps them off the ring while it goes. */
+int CaptureStart(struct GenetUnit *unit, ULONG snapLen)
+{
+    struct GenetCapture *c = &unit->capture;
+
+    if (snapLen > GENET_CAPTURE_SNAP_MAX)
+        snapLen = GENET_CAPTURE_SNAP_MAX;
+
+    if (c->slots == NULL)
+    {
+        struct CaptureSlot *slots = UnitAllocPooled(unit, CAPTURE_SLOTS * sizeof(struct CaptureSlot), GENET_POOL_CAPTURE);
+        if (slots == NULL)
+            return S2ERR_NO_RESOURCES;
+        for (ULONG i = 0; i < CAPTURE_SLOTS; i++)
+            slots[i].captured = 0;
+
+        c->head = 0;
+        c->tail = 0;
+        c->captured = 0;
+        c->dropped = 0;
+        ObtainSemaphore(&unit->tx_ring.tx_ring_sem);
+        c->slots = slots;
+        bcmgenet_tx_ring_release(unit);
+    }
+    c->snapLen = snapLen;
+    Kprintf("[genet] %s: Capturing %ld bytes per frame\n", __func__, snapLen);
+    return S2ERR_NO_ERROR;
+}
+
+void CaptureStop(struct GenetUnit *unit)
+{
+    struct GenetCapture *c = &unit->capture;
+    struct CaptureSlot *slots = c->slots;
+
+    if (slots == NULL)
+        return;
+
+    ObtainSemaphore(&unit->tx_ring.tx_ring_sem);
+    c->slots = NULL;
+    bcmgenet_tx_ring_release(unit);
+    UnitFreePooled(unit, slots, CAPTURE_SLOTS * sizeof(struct CaptureSlot), GENET_POOL_CAPTURE);
+    Kprintf("[genet] %s: Capture stopped, %ld frames captured, %ld dropped\n", __func__, c->captured, c->dropped);
+}
+
+void CaptureRecord(struct GenetCapture *c, const UBYTE *header, ULONG headerLength, const UBYTE *data, ULONG dataLength)
+{
+    /* Writers can be the unit task and callers of BeginIO, claim the slot atomically and never wait for the reader */
+    ULONG head = __atomic_load_n(&c->head, __ATOMIC_RELAXED);
+    do
+    {
+        if (head - __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE) >= CAPTURE_SLOTS)
+        {
+            __atomic_fetch_add(&c->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&c->head, &head, head + 1, TRUE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    struct CaptureSlot *slot = &c->slots[head & (CAPTURE_SLOTS - 1)];
+    ULONG length = headerLength + dataLength;
+    ULONG captured = length < c->snapLen ? length : c->snapLen;
+    ULONG fromHeader = captured < headerLength ? captured : headerLength;
+
+    slot->timestamp = timer_get_us();
+    slot->length = length;
+    if (fromHeader)
+        CopyMem((APTR)header, slot->data, fromHeader);
+    if (captured > fromHeader)
+        CopyMem((APTR)data, &slot->data[fromHeader], captured - fromHeader);
+
+    __atomic_fetch_add(&c->captured, 1, __ATOMIC_RELAXED);
+    /* Publish last, the reader skips slots still being written */
+    __atomic_store_n(&slot->captured, captured, __ATOMIC_RELEASE);
+}
+
+/* Unit task only. Hands out the oldest finished slots that fit, then frees them for the writers. */
+void CaptureDump(struct GenetCapture *c, struct GenetCaptureDump *dump, ULONG size)
+{
+    const ULONG header = offsetof(struct GenetCaptureDump, Data);
+    UBYTE *out = dump->Data;
+    UBYTE *end = (UBYTE *)dump + size;
+    ULONG count = 0;
+
+    struct PcapHeader *ph = (struct PcapHeader *)out;
+    ph->magic = PCAP_MAGIC;
+    ph->versionMajor = 2;
+    ph->versionMinor = 4;
+    ph->thisZone = 0;
+    ph->sigFigs = 0;
+    ph->snapLen = c->slots ? c->snapLen : GENET_CAPTURE_SNAP_MAX;
+    ph->linkType = PCAP_LINKTYPE_ETHERNET;
+    out += sizeof(struct PcapHeader);
+
+    ULONG tail = c->tail;
+    while (c->slots && tail != __atomic_load_n(&c->head, __ATOMIC_ACQUIRE))
+    {
+        struct CaptureSlot *slot = &c->slots[tail & (CAPTURE_SLOTS - 1)];
+        ULONG captured = __atomic_load_n(&slot->captured, __ATOMIC_ACQUIRE);
+        if (captured == 0 || out + sizeof(struct PcapRecord) + captured > end)
+            break;
+
+        struct PcapRecord *rec = (struct PcapRecord *)out;
+        rec->seconds = slot->timestamp / 1000000;
+        rec->microseconds = slot->timestamp % 1000000;
+        rec->capturedLength = captured < slot->length ? captured : slot->length;
+        rec->length = slot->length;
+        CopyMem(slot->data, out + sizeof(struct PcapRecord), rec->capturedLength);
+        out += sizeof(struct PcapRecord) + rec->capturedLength;
+
+        slot->captured = 0;
+        __atomic_store_n(&c->tail, ++tail, __ATOMIC_RELEASE);
+        count++;
+    }
+
+    dump->SnapLen = c->slots ? c->snapLen : 0;
+    dump->Captured = c->captured;
+    dump->Dropped = c->dropped;
+    dump->Count = count;
+    dump->Length = out - dump->Data;
+    dump->SizeSupplied = header + dump->Length;
+}
@@ -22,6 +22,7 @@
 #include <debug.h>
 #include <settings.h>
 #include <runtime_config.h>
+#include <trace.h>
 
 /*
     Put the function at the very beginning of the file in order to avoid
@@ -104,7 +105,8 @@ APTR initFunction(struct GenetDevice *base asm("d0"), ULONG segList asm("a0"), s
     Kprintf("[genet] %s: Initializing device\n", __func__);
     base->segList = segList;
     base->device.dd_Library.lib_Revision = DEVICE_REVISION;
-    base->unit = NULL;
+    for (int i = 0; i < GENET_MAX_UNITS; i++)
+        base->units[i] = NULL;
 
     UtilityBase = OpenLibrary((CONST_STRPTR)"utility.library", LIB_MIN_VERSION);
     if (UtilityBase == NULL)
@@ -116,10 +118,28 @@ APTR initFunction(struct GenetDevice *base asm("d0"), ULONG segList asm("a0"), s
 
     LoadGenetRuntimeConfig();
     DumpGenetRuntimeConfig();
+    TraceControl(genetConfig.trace ? GENET_TRACEF_ENABLE : 0);
 
     return base;
 }
 
+/* Rounded up so the hot blocks of GenetUnit start on a cache line */
+static struct GenetUnit *AllocUnit(void)
+{
+    APTR memory = AllocMem(sizeof(struct GenetUnit) + UNIT_CACHELINE, MEMF_FAST | MEMF_PUBLIC | MEMF_CLEAR);
+    if (memory == NULL)
+        return NULL;
+
+    struct GenetUnit *unit = (struct GenetUnit *)(((ULONG)memory + UNIT_CACHELINE - 1) & ~(UNIT_CACHELINE - 1));
+    unit->allocation = memory;
+    return unit;
+}
+
+static void FreeUnit(struct GenetUnit *unit)
+{
+    FreeMem(unit->allocation, sizeof(struct GenetUnit) + UNIT_CACHELINE);
+}
+
 #define getBufferFunction(tags, tag32, tag16, tagDefault)     \
     ({                                                        \
         APTR func = (APTR)GetTagData(tagDefault, NULL, tags); \
@@ -166,6 +186,8 @@ struct Opener *createOpener(struct TagItem *tags)
     Kprintf("[genet] %s: DMACopyToBuff=%lx, DMACopyFromBuff=%lx\n",
             __func__, opener->DMACopyToBuff, opener->DMACopyFromBuff);
 
+    SetupOpenerDelivery(opener);
+
     _NewMinList(&opener->readQueue);
     _NewMinList(&opener->orphanQueue);
     _NewMinList(&opener->eventQueue);
@@ -181,7 +203,7 @@ void openLib(struct IOSana2Req *io asm("a1"), LONG unitNumber asm("d0"),
              ULONG flags asm("d1"), struct GenetDevice *base asm("a6"))
 {
     Kprintf("[genet] %s: Opening device with unit number %ld and flags %lx\n", __func__, unitNumber, flags);
-    if (unitNumber != 0)
+    if (unitNumber < 0 || unitNumber >= GENET_MAX_UNITS)
     {
         Kprintf("[genet] %s: Invalid unit number %ld\n", __func__, unitNumber);
         io->ios2_Req.io_Error = IOERR_OPENFAIL;
@@ -195,19 +217,21 @@ void openLib(struct IOSana2Req *io asm("a1"), LONG unitNumber asm("d0"),
         return;
     }
 
-    if (base->unit == NULL)
+    struct GenetUnit *unit = base->units[unitNumber];
+    if (unit == NULL)
     {
         Kprintf("[genet] %s: Allocating unit structure\n", __func__);
-        base->unit = AllocMem(sizeof(struct GenetUnit), MEMF_FAST | MEMF_PUBLIC | MEMF_CLEAR);
-        if (base->unit == NULL)
+        unit = AllocUnit();
+        if (unit == NULL)
         {
             Kprintf("[genet]%s: Failed to allocate unit\n", __func__);
             io->ios2_Req.io_Error = IOERR_OPENFAIL;
             return;
         }
+        base->units[unitNumber] = unit;
     }
 
-    if (flags & SANA2OPF_MINE && base->unit->unit.unit_OpenCnt > 0)
+    if (flags & SANA2OPF_MINE && unit->unit.unit_OpenCnt > 0)
     {
         Kprintf("[genet] %s: Unit is already open, can't do exclusive access\n", __func__);
         io->ios2_Req.io_Error = IOERR_UNITBUSY;
@@ -221,22 +245,23 @@ void openLib(struct IOSana2Req *io asm("a1"), LONG unitNumber asm("d0"),
         if (opener == NULL)
         {
             io->ios2_Req.io_Error = IOERR_OPENFAIL;
-            if (base->unit)
+            if (unit->unit.unit_OpenCnt == 0)
             {
-                FreeMem(base->unit, sizeof(struct GenetUnit));
-                base->unit = NULL;
+                FreeUnit(unit);
+                base->units[unitNumber] = NULL;
             }
             return;
         }
+        opener->promiscuous = (flags & SANA2OPF_PROM) != 0;
         io->ios2_BufferManagement = opener;
     }
 
-    int result = UnitOpen(base->unit, unitNumber, flags, opener);
-    io->ios2_Req.io_Unit = (struct Unit *)base->unit;
+    int result = UnitOpen(unit, unitNumber, flags, opener);
 
     if (result == S2ERR_NO_ERROR)
     {
         Kprintf("[genet] %s: Unit opened successfully\n", __func__);
+        io->ios2_Req.io_Unit = (struct Unit *)unit;
         base->device.dd_Library.lib_OpenCnt++;
         base->device.dd_Library.lib_Flags &= ~LIBF_DELEXP;
         io->ios2_Req.io_Message.mn_Node.ln_Type = NT_REPLYMSG;
@@ -245,6 +270,13 @@ void openLib(struct IOSana2Req *io asm("a1"), LONG unitNumber asm("d0"),
     {
         Kprintf("[genet] %s: Failed to open unit, error code %ld\n", __func__, result);
         io->ios2_Req.io_Error = IOERR_OPENFAIL;
+        if (opener != NULL)
+            FreeMem(opener, sizeof(struct Opener));
+        if (unit->unit.unit_OpenCnt == 0)
+        {
+            FreeUnit(unit);
+            base->units[unitNumber] = NULL;
+        }
     }
 
     /* In contrast to normal library there is no need to return anything */
@@ -266,8 +298,9 @@ ULONG closeLib(struct IOSana2Req *io asm("a1"), struct GenetDevice *base asm("a6
     if (result == 0) // last user of Unit disappeared
     {
         Kprintf("[genet] %s: Unit closed successfully, freeing resources\n", __func__);
-        FreeMem(unit, sizeof(struct GenetUnit));
-        base->unit = NULL;
+        LONG unitNumber = unit->unitNumber;
+        FreeUnit(unit);
+        base->units[unitNumber] = NULL;
     }
     if (opener != NULL)
     {
@@ -11,25 +11,89 @@
 #include <device.h>
 #include <debug.h>
 
+/* Requests waiting on the unit port are removed with interrupts off, as exec's PutMsg/GetMsg do */
+static BOOL AbortFromPort(struct GenetUnit *unit, struct IOSana2Req *io)
+{
+    BOOL found = FALSE;
+    Disable();
+    for (struct Node *node = unit->unit.unit_MsgPort.mp_MsgList.lh_Head; node->ln_Succ; node = node->ln_Succ)
+    {
+        if (node == &io->ios2_Req.io_Message.mn_Node)
+        {
+            Remove(node);
+            REQUEST_OWNER(io) = NULL;
+            found = TRUE;
+            break;
+        }
+    }
+    Enable();
+    return found;
+}
+
+/* Opener queues are protected by the opener semaphore, the same lock ReceiveFrame takes */
+static BOOL AbortFromOpener(struct Opener *opener, struct IOSana2Req *io)
+{
+    BOOL found = FALSE;
+    ObtainSemaphore(&opener->openerSemaphore);
+    struct MinList *owner = REQUEST_OWNER(io);
+    if (owner == &opener->readQueue || owner == &opener->orphanQueue || owner == &opener->eventQueue ||
+        owner == &opener->ipv4Queue || owner == &opener->arpQueue)
+    {
+        UnqueueRequest(io);
+        found = TRUE;
+    }
+    ReleaseSemaphore(&opener->openerSemaphore);
+    return found;
+}
+
+/* Writes waiting for the TX ring are protected by the ring lock */
+static BOOL AbortFromBacklog(struct GenetUnit *unit, struct IOSana2Req *io)
+{
+    struct bcmgenet_tx_ring *ring = &unit->tx_ring;
+    BOOL found = FALSE;
+    ObtainSemaphore(&ring->tx_ring_sem);
+    if (REQUEST_OWNER(io) == &ring->tx_backlog)
+    {
+        UnqueueRequest(io);
+        ring->tx_backlog_count--;
+        found = TRUE;
+    }
+    else if (REQUEST_OWNER(io) == &ring->tso_wait)
+    {
+        UnqueueRequest(io);
+        found = TRUE;
+    }
+    bcmgenet_tx_ring_release(unit);
+    return found;
+}
+
 LONG abortIO(struct IOSana2Req *io asm("a1"), struct GenetDevice *base asm("a6") __attribute__((unused)))
 {
     /* AbortIO is a *wish* call. Someone would like to abort current IORequest */
     KprintfH("[genet] %s: Aborting IO request %lx\n", __func__, io);
 
-    if (io->ios2_Req.io_Unit != NULL)
+    struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+    if (unit == NULL)
+        return 0;
+
+    /* The owner is only a hint here, it is checked again under the lock of the list it names.
+     * Requests that are being processed or sit on the TX ring have no owner and are left alone.
+     */
+    struct MinList *owner = REQUEST_OWNER(io);
+    BOOL found = FALSE;
+    if (owner == (struct MinList *)&unit->unit.unit_MsgPort.mp_MsgList)
+        found = AbortFromPort(unit, io);
+    else if (owner == &unit->tx_ring.tx_backlog || owner == &unit->tx_ring.tso_wait)
+        found = AbortFromBacklog(unit, io);
+    else if (owner != NULL && io->ios2_BufferManagement != NULL)
+        found = AbortFromOpener(io->ios2_BufferManagement, io);
+
+    if (found)
     {
-        Forbid();
-        /* If the IO was not quick and is of type message (not handled yet or in process), abord it and remove from queue. 
-         * The TX task clears ln_Pred to indicate the request is already on TX ring and can't be cancelled. */
-        if ((io->ios2_Req.io_Flags & IOF_QUICK) == 0 && io->ios2_Req.io_Message.mn_Node.ln_Type == NT_MESSAGE && io->ios2_Req.io_Message.mn_Node.ln_Pred != NULL)
-        {
-            Remove(&io->ios2_Req.io_Message.mn_Node);
-            io->ios2_Req.io_Error = IOERR_ABORTED;
-            io->ios2_WireError = S2WERR_GENERIC_ERROR;
-            ReplyMsg(&io->ios2_Req.io_Message);
-        }
-        Permit();
+        io->ios2_Req.io_Error = IOERR_ABORTED;
+        io->ios2_WireError = S2WERR_GENERIC_ERROR;
+        ReplyMsg(&io->ios2_Req.io_Message);
+        KprintfH("[genet] %s: IO request %lx aborted\n", __func__, io);
     }
-    KprintfH("[genet] %s: IO request %lx aborted\n", __func__, io);
     return 0;
 }
@@ -13,14 +13,16 @@
 void beginIO(struct IOSana2Req *io asm("a1"), struct GenetDevice *base asm("a6") __attribute__((unused)))
 {
     struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+    REQUEST_OWNER(io) = NULL;
 
-    if ((io->ios2_Req.io_Command == CMD_WRITE || io->ios2_Req.io_Command == S2_BROADCAST) && AttemptSemaphore(&unit->tx_ring.tx_ring_sem))
+    if (io->ios2_Req.io_Command == CMD_WRITE || io->ios2_Req.io_Command == S2_BROADCAST || io->ios2_Req.io_Command == S2_MULTICAST ||
+        io->ios2_Req.io_Command == GENET_CMD_TSOWRITE)
     {
-        KprintfH("[genet] %s: Quick CMD_WRITE\n", __func__);
-        if (unit->tx_ring.free_bds < 10)
-            bcmgenet_tx_reclaim(unit);
-        ProcessCommand(io);
-        ReleaseSemaphore(&unit->tx_ring.tx_ring_sem);
+        /* Writes never go through the unit port. If the ring is busy, its owner sends them on release. */
+        KprintfH("[genet] %s: Submitting %04lx\n", __func__, io->ios2_Req.io_Command);
+        io->ios2_Req.io_Error = S2ERR_NO_ERROR;
+        io->ios2_Req.io_Flags &= ~IOF_QUICK;
+        bcmgenet_tx_submit(unit, io);
     }
     else if (io->ios2_Req.io_Command == CMD_READ && AttemptSemaphore(&((struct Opener *)io->ios2_BufferManagement)->openerSemaphore))
     {
@@ -33,6 +35,7 @@ void beginIO(struct IOSana2Req *io asm("a1"), struct GenetDevice *base asm("a6")
         KprintfH("[genet] %s: Queuing %04lx\n", __func__, io->ios2_Req.io_Command);
         io->ios2_Req.io_Error = S2ERR_NO_ERROR;
         io->ios2_Req.io_Flags &= ~IOF_QUICK;
+        REQUEST_OWNER(io) = (struct MinList *)&unit->unit.unit_MsgPort.mp_MsgList;
         PutMsg(&unit->unit.unit_MsgPort, (struct Message *)io);
     }
 }
@@ -13,9 +13,11 @@
 
 #include <debug.h>
 #include <device.h>
+#include <gpio/bcm_gpio.h>
 #include <compat.h>
 
 APTR DeviceTreeBase;
+APTR SystemTimerBase = (APTR)0xf2003000; // Until the devicetree says otherwise
 
 // Devicetree extras
 static APTR DT_FindByPHandle(APTR key, ULONG phandle)
@@ -38,6 +40,40 @@ static APTR DT_FindByPHandle(APTR key, ULONG phandle)
 	return NULL;
 }
 
+static BOOL DT_IsCompatible(APTR key, CONST_STRPTR compatible)
+{
+	APTR p = DT_FindProperty(key, (CONST_STRPTR) "compatible");
+	if (p == NULL)
+		return FALSE;
+
+	// String list, one NUL terminated entry after the other
+	CONST_STRPTR value = DT_GetPropValue(p);
+	CONST_STRPTR end = value + DT_GetPropLen(p);
+	while (value < end)
+	{
+		if (!Stricmp((STRPTR)value, (STRPTR)compatible))
+			return TRUE;
+		while (value < end && *value != 0)
+			value++;
+		value++;
+	}
+	return FALSE;
+}
+
+static APTR DT_FindCompatible(APTR key, CONST_STRPTR compatible)
+{
+	if (DT_IsCompatible(key, compatible))
+		return key;
+
+	for (APTR c = DT_GetChild(key, NULL); c; c = DT_GetChild(key, c))
+	{
+		APTR found = DT_FindCompatible(c, compatible);
+		if (found)
+			return found;
+	}
+	return NULL;
+}
+
 static ULONG DT_GetPropertyValueULONG(APTR key, const char *propname, ULONG def_val, BOOL check_parent)
 {
 	ULONG ret = def_val;
@@ -97,6 +133,18 @@ static ULONG GetAddressTranslationOffset(APTR address)
 	return 0;
 }
 
+static APTR GetRegAddress(APTR key)
+{
+	ULONG address_cells = DT_GetPropertyValueULONG(DT_GetParent(key), "#address-cells", 2, FALSE);
+
+	const ULONG *reg = DT_GetPropValue(DT_FindProperty(key, (CONST_STRPTR) "reg"));
+	if (reg != NULL)
+		return (APTR)reg[address_cells - 1];
+
+	Kprintf("[genet] %s: Failed to find reg property in key %s\n", __func__, DT_GetKeyName(key));
+	return NULL;
+}
+
 static APTR GetBaseAddress(CONST_STRPTR alias)
 {
 	APTR key = DT_OpenKey(alias);
@@ -106,17 +154,92 @@ static APTR GetBaseAddress(CONST_STRPTR alias)
 		return NULL;
 	}
 
-	ULONG address_cells = DT_GetPropertyValueULONG(DT_GetParent(key), "#address-cells", 2, FALSE);
+	APTR address = GetRegAddress(key);
+	DT_CloseKey(key);
+	return address;
+}
 
-	const ULONG *reg = DT_GetPropValue(DT_FindProperty(key, (CONST_STRPTR) "reg"));
-	if (reg != NULL)
+static void GetSystemTimer(APTR root)
+{
+	APTR key = DT_FindCompatible(root, (CONST_STRPTR) "brcm,bcm2835-system-timer");
+	APTR base = key ? GetRegAddress(key) : NULL;
+	if (base == NULL)
 	{
-		DT_CloseKey(key);
-		return (APTR)reg[address_cells - 1];
+		Kprintf("[genet] %s: No system timer in device tree, keeping %08lx\n", __func__, SystemTimerBase);
+		return;
+	}
+
+	SystemTimerBase = (APTR)((ULONG)base + GetAddressTranslationOffset(base));
+	Kprintf("[genet] %s: System timer base address in CPU space: %08lx\n", __func__, SystemTimerBase);
+}
+
+static void AddPinGroup(struct GenetUnit *unit, APTR group)
+{
+	APTR pinsProp = DT_FindProperty(group, (CONST_STRPTR) "brcm,pins");
+	APTR functionProp = DT_FindProperty(group, (CONST_STRPTR) "brcm,function");
+	APTR pullProp = DT_FindProperty(group, (CONST_STRPTR) "brcm,pull");
+	if (pinsProp == NULL)
+		return;
+
+	// brcm,function and brcm,pull have either one cell per pin or one cell for all of them
+	const ULONG *pins = DT_GetPropValue(pinsProp);
+	const ULONG pinCount = DT_GetPropLen(pinsProp) / 4;
+	const ULONG *functions = functionProp ? DT_GetPropValue(functionProp) : NULL;
+	const ULONG functionCount = functionProp ? DT_GetPropLen(functionProp) / 4 : 0;
+	const ULONG *pulls = pullProp ? DT_GetPropValue(pullProp) : NULL;
+	const ULONG pullCount = pullProp ? DT_GetPropLen(pullProp) / 4 : 0;
+
+	for (ULONG i = 0; i < pinCount && unit->pinCount < GENET_MAX_PINS; i++)
+	{
+		struct GenetPin *pin = &unit->pins[unit->pinCount++];
+		pin->pin = pins[i];
+		pin->function = functionCount ? functions[i < functionCount ? i : 0] : GPIO_AF_INPUT;
+
+		// Devicetree encoding is 0 = none, 1 = down, 2 = up
+		ULONG pull = pullCount ? pulls[i < pullCount ? i : 0] : 0;
+		pin->pull = pull == 1 ? GPIO_PULL_DOWN : pull == 2 ? GPIO_PULL_UP : GPIO_PULL_OFF;
+	}
+}
+
+static void AddPinctrl(struct GenetUnit *unit, APTR root, APTR key)
+{
+	APTR p = DT_FindProperty(key, (CONST_STRPTR) "pinctrl-0");
+	if (p == NULL || root == NULL)
+		return;
+
+	const ULONG *handles = DT_GetPropValue(p);
+	for (ULONG i = 0; i < DT_GetPropLen(p) / 4; i++)
+	{
+		APTR group = DT_FindByPHandle(root, handles[i]);
+		if (group)
+			AddPinGroup(unit, group);
 	}
-	Kprintf("[genet] %s: Failed to find reg property in key %s\n", __func__, alias);
-	DT_CloseKey(key);
-	return NULL;
+}
+
+static void GetPins(struct GenetUnit *unit, APTR root, APTR key)
+{
+	unit->pinCount = 0;
+
+	// Pin groups may hang off the MAC node or its MDIO child
+	AddPinctrl(unit, root, key);
+	for (APTR c = DT_GetChild(key, NULL); c; c = DT_GetChild(key, c))
+		AddPinctrl(unit, root, c);
+
+	if (unit->pinCount == 0)
+	{
+		// RPi4 wiring: MDIO on ALT5, RGMII pins as inputs
+		Kprintf("[genet] %s: No pinctrl in device tree, using RPi4 pins\n", __func__);
+		unit->pins[0] = (struct GenetPin){PIN_RGMII_MDIO, GPIO_AF_5, GPIO_PULL_UP};
+		unit->pins[1] = (struct GenetPin){PIN_RGMII_MDC, GPIO_AF_5, GPIO_PULL_DOWN};
+		unit->pinCount = 2;
+		for (int i = 46; i < 58; i++)
+		{
+			unit->pins[unit->pinCount++] = (struct GenetPin){i, GPIO_AF_INPUT, i < 48 ? GPIO_PULL_UP : GPIO_PULL_DOWN};
+		}
+	}
+
+	for (int i = 0; i < unit->pinCount; i++)
+		Kprintf("[genet] %s: pin %ld function %ld pull %ld\n", __func__, unit->pins[i].pin, unit->pins[i].function, unit->pins[i].pull);
 }
 
 static CONST_STRPTR GetAlias(const char *alias)
@@ -220,6 +343,14 @@ int DevTreeParse(struct GenetUnit *unit)
 	Kprintf("[genet] %s: Found GENET in CPU space, base address in CPU space: %08lx\n", __func__, unit->genetBase);
 	Kprintf("[genet] %s: Found GPIO in CPU space, base address in CPU space: %08lx\n", __func__, unit->gpioBase);
 
+	// Remaining resources have built-in fallbacks
+	APTR root = DT_OpenKey((CONST_STRPTR) "/");
+	if (root)
+		GetSystemTimer(root);
+	GetPins(unit, root, key);
+	if (root)
+		DT_CloseKey(root);
+
 	// We're done with the device tree
 	DT_CloseKey(key);
 	return 0;
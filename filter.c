@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: MPL-2.0 OR GPL-2.0+
+#ifdef __INTELLISENSE__
+#include <clib/exec_protos.h>
+#else
+#include <proto/exec.h>
+#endif
+
+#include <device.h>
+#include <filter.h>
+#include <debug.h>
+
+/* Where each GENET_FIELD_* lives */
+static const struct
+{
+    UBYTE layer;
+    UBYTE offset;
+    UBYTE width;
+} fields[GENET_FIELDS] = {
+    [GENET_FIELD_ETHERTYPE] = {FILTER_L2, 12, 2},
+    [GENET_FIELD_IP_PROTO] = {FILTER_L3, 9, 1},
+    [GENET_FIELD_IP_SRC] = {FILTER_L3, 12, 4},
+    [GENET_FIELD_IP_DST] = {FILTER_L3, 16, 4},
+    [GENET_FIELD_SRC_PORT] = {FILTER_L4, 0, 2},
+    [GENET_FIELD_DST_PORT] = {FILTER_L4, 2, 2},
+};
+
+static int FilterCompile(struct PacketFilter *filter, const struct GenetFilterInsn *program, ULONG count)
+{
+    for (ULONG pc = 0; pc < count; pc++)
+    {
+        const struct GenetFilterInsn *in = &program[pc];
+        struct FilterInsn *out = &filter->insn[pc];
+
+        out->op = in->Op;
+        if (in->Op == GENET_FILTER_ACCEPT || in->Op == GENET_FILTER_REJECT)
+            continue;
+
+        /* Jumps stay inside the program, so it always ends on ACCEPT or REJECT */
+        if ((in->Op != GENET_FILTER_JEQ && in->Op != GENET_FILTER_JGE) || in->Field >= GENET_FIELDS ||
+            pc + 1 + in->JumpTrue >= count || pc + 1 + in->JumpFalse >= count)
+        {
+            Kprintf("[genet] %s: Bad instruction %ld\n", __func__, pc);
+            return S2ERR_BAD_ARGUMENT;
+        }
+
+        ULONG widthMask = fields[in->Field].width == 4 ? 0xffffffff : (1UL << (fields[in->Field].width * 8)) - 1;
+        out->layer = fields[in->Field].layer;
+        out->offset = fields[in->Field].offset;
+        out->width = fields[in->Field].width;
+        out->jumpTrue = pc + 1 + in->JumpTrue;
+        out->jumpFalse = pc + 1 + in->JumpFalse;
+        out->mask = in->Mask ? in->Mask & widthMask : widthMask;
+        out->value = in->Value & out->mask;
+    }
+    filter->count = count;
+    return S2ERR_NO_ERROR;
+}
+
+/* Unit task only, ReceiveFrame runs there too and never sees a half set filter */
+int FilterSet(struct GenetUnit *unit, struct Opener *opener, const struct GenetFilterInsn *program, ULONG count)
+{
+    struct PacketFilter *filter = NULL;
+
+    if (count > GENET_FILTER_MAX || (count && program == NULL))
+        return S2ERR_BAD_ARGUMENT;
+
+    if (count)
+    {
+        ULONG size = sizeof(struct PacketFilter) + count * sizeof(struct FilterInsn);
+        filter = UnitAllocPooled(unit, size, GENET_POOL_FILTER);
+        if (filter == NULL)
+            return S2ERR_NO_RESOURCES;
+        filter->size = size;
+
+        int error = FilterCompile(filter, program, count);
+        if (error != S2ERR_NO_ERROR)
+        {
+            UnitFreePooled(unit, filter, size, GENET_POOL_FILTER);
+            return error;
+        }
+    }
+
+    FilterFree(unit, opener);
+    opener->filter = filter;
+    return S2ERR_NO_ERROR;
+}
+
+void FilterFree(struct GenetUnit *unit, struct Opener *opener)
+{
+    if (opener->filter)
+    {
+        UnitFreePooled(unit, opener->filter, opener->filter->size, GENET_POOL_FILTER);
+        opener->filter = NULL;
+    }
+}
+
+/* Start of the IPv4 or TCP/UDP header, 0 if the frame has none */
+static ULONG HeaderStart(UBYTE layer, const UBYTE *packet, ULONG length)
+{
+    if (*(UWORD *)&packet[12] != 0x0800 || length < ETH_HLEN + 20)
+        return 0;
+    if (layer == FILTER_L3)
+        return ETH_HLEN;
+
+    ULONG ihl = (packet[ETH_HLEN] & 0x0f) * 4;
+    UBYTE proto = packet[ETH_HLEN + 9];
+    /* Fragment offset and more fragments bits, only the first fragment of a whole packet has ports */
+    if (ihl < 20 || (proto != 6 && proto != 17) || (*(UWORD *)&packet[ETH_HLEN + 6] & 0x3fff))
+        return 0;
+    return ETH_HLEN + ihl;
+}
+
+BOOL FilterRun(const struct PacketFilter *filter, const UBYTE *packet, ULONG length)
+{
+    /* Header starts are looked up once, on first use */
+    ULONG start[3] = {0, ~0UL, ~0UL};
+    UWORD pc = 0;
+
+    for (;;)
+    {
+        const struct FilterInsn *insn = &filter->insn[pc];
+
+        if (insn->op == GENET_FILTER_ACCEPT)
+            return TRUE;
+        if (insn->op == GENET_FILTER_REJECT)
+            return FALSE;
+
+        if (start[insn->layer] == ~0UL)
+            start[insn->layer] = HeaderStart(insn->layer, packet, length);
+
+        BOOL match = FALSE;
+        ULONG at = start[insn->layer] + insn->offset;
+        if ((insn->layer == FILTER_L2 || start[insn->layer] != 0) && at + insn->width <= length)
+        {
+            ULONG v = insn->width == 4 ? *(ULONG *)&packet[at] : insn->width == 2 ? *(UWORD *)&packet[at] : packet[at];
+            v &= insn->mask;
+            match = insn->op == GENET_FILTER_JEQ ? v == insn->value : v >= insn->value;
+        }
+        pc = match ? insn->jumpTrue : insn->jumpFalse;
+    }
+}
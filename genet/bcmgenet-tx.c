@@ -17,6 +17,7 @@
 #include <debug.h>
 #include <settings.h>
 #include <runtime_config.h>
+#include <trace.h>
 
 /* Combined address + length/status setter */
 static inline void dmadesc_set(APTR descriptor_address, APTR addr, ULONG val)
@@ -25,11 +26,64 @@ static inline void dmadesc_set(APTR descriptor_address, APTR addr, ULONG val)
 	writel(val, descriptor_address + DMA_DESC_LENGTH_STATUS);
 }
 
-static inline struct enet_cb *bcmgenet_get_txcb(struct bcmgenet_tx_ring *ring)
+static inline struct enet_cb *bcmgenet_get_txcb(struct bcmgenet_tx_ring *ring, UBYTE offset)
 {
-	struct enet_cb *tx_cb_ptr = &ring->tx_control_block[ring->write_ptr++];
-	KprintfH("[genet] %s: tx_cb_ptr 0x%lx, write_ptr %ld\n", __func__, tx_cb_ptr, ring->write_ptr - 1);
-	return tx_cb_ptr;
+	return &ring->tx_control_block[(UBYTE)(ring->write_ptr + offset)];
+}
+
+void bcmgenet_tx_buf_init(struct GenetUnit *unit)
+{
+	static const UWORD sizes[TX_BUF_CLASSES] = TX_BUF_CLASS_SIZES;
+	static const UWORD counts[TX_BUF_CLASSES] = TX_BUF_CLASS_COUNTS;
+	struct bcmgenet_tx_ring *ring = &unit->tx_ring;
+	UBYTE *slot = unit->txbuffer;
+
+	for (int c = 0; c < TX_BUF_CLASSES; c++)
+	{
+		struct tx_buf_class *cls = &ring->buf_class[c];
+		cls->size = sizes[c];
+		cls->free_list = NULL;
+
+		/* Push in reverse so the lowest addresses are handed out first */
+		slot += sizes[c] * counts[c];
+		for (int i = 0; i < counts[c]; i++)
+		{
+			APTR s = slot - (i + 1) * sizes[c];
+			*(APTR *)s = cls->free_list;
+			cls->free_list = s;
+		}
+		Kprintf("[genet] %s: class %ld: %ld x %ld bytes\n", __func__, c, counts[c], sizes[c]);
+	}
+}
+
+/* Takes the smallest free slot that fits len. Slots are recycled LIFO, so
+ * the next packet reuses a buffer that is most likely still in the cache.
+ */
+static inline APTR bcmgenet_tx_buf_alloc(struct bcmgenet_tx_ring *ring, ULONG len, UBYTE *buf_class)
+{
+	for (UBYTE c = 0; c < TX_BUF_CLASSES; c++)
+	{
+		struct tx_buf_class *cls = &ring->buf_class[c];
+		if (len <= cls->size && cls->free_list != NULL)
+		{
+			APTR slot = cls->free_list;
+			cls->free_list = *(APTR *)slot;
+			*buf_class = c;
+			return slot;
+		}
+	}
+	return NULL;
+}
+
+static inline void bcmgenet_tx_buf_free(struct bcmgenet_tx_ring *ring, struct enet_cb *cb)
+{
+	if (cb->internal_buffer)
+	{
+		struct tx_buf_class *cls = &ring->buf_class[cb->buf_class];
+		*(APTR *)cb->internal_buffer = cls->free_list;
+		cls->free_list = cb->internal_buffer;
+		cb->internal_buffer = NULL;
+	}
 }
 
 /* Simple helper to free a transmit control block's resources
@@ -48,8 +102,11 @@ static inline struct IOSana2Req *bcmgenet_free_tx_cb(struct enet_cb *cb)
 	return NULL;
 }
 
+static void bcmgenet_tx_backlog_refill(struct GenetUnit *unit);
+static void bcmgenet_tx_tso_refill(struct GenetUnit *unit);
+
 /* Unlocked version of the reclaim routine */
-void bcmgenet_tx_reclaim(struct GenetUnit *unit)
+UWORD bcmgenet_tx_reclaim(struct GenetUnit *unit)
 {
 	struct bcmgenet_tx_ring *ring = &unit->tx_ring;
 	ObtainSemaphore(&ring->tx_ring_sem);
@@ -61,15 +118,29 @@ void bcmgenet_tx_reclaim(struct GenetUnit *unit)
 	UWORD txbds_processed = 0;
 	ULONG bytes_compl = 0;
 	UWORD pkts_compl = 0;
+	ULONG now = txbds_ready ? timer_get_us() : 0;
 	while (txbds_processed < txbds_ready)
 	{
-		struct IOSana2Req *io = bcmgenet_free_tx_cb(&ring->tx_control_block[ring->clean_ptr]);
+		struct enet_cb *cb = &ring->tx_control_block[ring->clean_ptr];
+		bcmgenet_tx_buf_free(ring, cb);
+		struct IOSana2Req *io = bcmgenet_free_tx_cb(cb);
 		if (io)
 		{
+			if (unlikely(io == ring->tso_io))
+				ring->tso_io = NULL;
 			pkts_compl++;
 			bytes_compl += io->ios2_DataLength;
-			KprintfH("[genet] %s: Reclaimed tx buffer 0x%lx, length %ld\n", __func__, io, io->ios2_DataLength);
-			ReplyMsg((struct Message *)io);
+			if (likely(!genetConfig.tx_reply_batch))
+			{
+				LatencyRecord(&unit->latency.Tx, now - REQUEST_TIMESTAMP(io));
+				ReplyMsg((struct Message *)io);
+			}
+			else
+			{
+				if (ring->tx_done_count++ == 0)
+					ring->tx_done_time = now;
+				AddTailMinList(&ring->tx_done, (struct MinNode *)io);
+			}
 		}
 
 		++txbds_processed;
@@ -79,46 +150,378 @@ void bcmgenet_tx_reclaim(struct GenetUnit *unit)
 	ring->free_bds += txbds_processed;
 	ring->tx_cons_index = tx_cons_index;
 
+	if (unlikely(ring->tso_io == NULL && ring->tso_wait.mlh_TailPred != (struct MinNode *)&ring->tso_wait) &&
+		txbds_processed && unit->state == STATE_ONLINE)
+		bcmgenet_tx_tso_refill(unit);
+
+	if (unlikely(ring->tx_backlog_count) && txbds_processed && unit->state == STATE_ONLINE)
+		bcmgenet_tx_backlog_refill(unit);
+
+	/* Without limits the batch is one reclaim pass, otherwise hold it until either limit is reached.
+	 * Nothing is held once the unit goes offline or the ring runs empty, no more completions
+	 * may come to fill a count-only batch then.
+	 */
+	if (ring->tx_done_count)
+	{
+		ULONG max = genetConfig.tx_reply_batch_max;
+		ULONG us = genetConfig.tx_reply_batch_us;
+		if (unit->state != STATE_ONLINE || ring->free_bds == TX_DESCS || (max == 0 && us == 0) ||
+			(max && ring->tx_done_count >= max) ||
+			(us && timer_get_us() - ring->tx_done_time >= us))
+		{
+			ULONG replied = timer_get_us();
+			for (struct MinNode *node = ring->tx_done.mlh_Head; node->mln_Succ; node = node->mln_Succ)
+				LatencyRecord(&unit->latency.Tx, replied - REQUEST_TIMESTAMP((struct IOSana2Req *)node));
+			ReplyRequestList(&ring->tx_done);
+			ring->tx_done_count = 0;
+			unit->internalStats.tx_reply_batches++;
+		}
+	}
+
+	if (pkts_compl)
+		Trace(GENET_TRACE_TX_RECLAIM, unit->unitNumber, pkts_compl, ring->free_bds, tx_cons_index);
+
 	/* small burst of fast polls */
 	unit->tx_watchdog_fast_ticks = (ring->free_bds < TX_DESCS) ? genetConfig.tx_pending_fast_ticks : 0;
 
 	unit->stats.PacketsSent += pkts_compl;
 	unit->internalStats.tx_packets += pkts_compl;
 	unit->internalStats.tx_bytes += bytes_compl;
+
+	bcmgenet_tx_ring_release(unit);
+	return pkts_compl;
+}
+
+#define SUBMIT_NEXT(io) (*(struct IOSana2Req **)&(io)->ios2_Req.io_Message.mn_Node.ln_Succ)
+
+/*
+ * Send all submitted writes if the TX ring is free. Whoever releases the
+ * ring afterwards checks the submission stack again, so a write pushed while
+ * the ring was busy is never left behind.
+ */
+void bcmgenet_tx_submit_drain(struct GenetUnit *unit)
+{
+	struct bcmgenet_tx_ring *ring = &unit->tx_ring;
+
+	while (ring->tx_submit != NULL && AttemptSemaphore(&ring->tx_ring_sem))
+	{
+		ring->tx_draining = TRUE;
+		struct IOSana2Req *list = __atomic_exchange_n(&ring->tx_submit, NULL, __ATOMIC_ACQUIRE);
+
+		/* The stack is LIFO, reverse it to keep submission order */
+		struct IOSana2Req *io = NULL;
+		while (list)
+		{
+			struct IOSana2Req *next = SUBMIT_NEXT(list);
+			SUBMIT_NEXT(list) = io;
+			io = list;
+			list = next;
+		}
+
+		if (unit->state == STATE_ONLINE && ring->free_bds < 10)
+			bcmgenet_tx_reclaim(unit);
+
+		while (io)
+		{
+			struct IOSana2Req *next = SUBMIT_NEXT(io);
+			ProcessCommand(io);
+			io = next;
+		}
+
+		ring->tx_draining = FALSE;
+		ReleaseSemaphore(&ring->tx_ring_sem);
+	}
+}
+
+/* Queue a write without waiting for the TX ring, callable from any task */
+void bcmgenet_tx_submit(struct GenetUnit *unit, struct IOSana2Req *io)
+{
+	struct bcmgenet_tx_ring *ring = &unit->tx_ring;
+	struct IOSana2Req *head = ring->tx_submit;
+
+	REQUEST_TIMESTAMP(io) = timer_get_us();
+	do
+	{
+		SUBMIT_NEXT(io) = head;
+	} while (!__atomic_compare_exchange_n(&ring->tx_submit, &head, io, TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	bcmgenet_tx_submit_drain(unit);
+}
+
+/*
+ * Every holder of tx_ring_sem but the drain itself releases it here. A write
+ * pushed while the ring was held would otherwise wait for the next reclaim,
+ * which a loopback unit never runs. Inside a drain the owner picks up new
+ * submissions itself.
+ */
+void bcmgenet_tx_ring_release(struct GenetUnit *unit)
+{
+	struct bcmgenet_tx_ring *ring = &unit->tx_ring;
+	BOOL draining = ring->tx_draining;
+
 	ReleaseSemaphore(&ring->tx_ring_sem);
+	if (!draining)
+		bcmgenet_tx_submit_drain(unit);
 }
 
-int bcmgenet_xmit(struct IOSana2Req *io, struct GenetUnit *unit)
+#define XMIT_BUSY 2 /* Ring or bounce buffers full, nothing was touched */
+
+#define TCP_FLAG_FIN 0x01
+#define TCP_FLAG_PSH 0x08
+#define TCP_FLAG_CWR 0x80
+
+/* Most segments a TSO write with this MSS can need, every one of them takes two descriptors */
+static inline ULONG bcmgenet_tso_segments_max(struct IOSana2Req *io)
+{
+	const ULONG mss = GENET_TSO_MSS(io);
+	return (io->ios2_DataLength - 40 + mss - 1) / mss;
+}
+
+/*
+ * Called with tx_ring_sem held and the staging buffer free. The packet is
+ * copied once into the staging buffer, which the data descriptors then point
+ * into, so only the headers are written per segment. All segments go on the
+ * ring together, with one producer index update.
+ */
+static int bcmgenet_xmit_tso_start(struct IOSana2Req *io, struct GenetUnit *unit)
 {
-	KprintfH("[genet] %s: unit %ld, io 0x%lx, flags 0x%lx\n", __func__, unit->unitNumber, io, io->ios2_Req.io_Flags);
 	struct Opener *opener = io->ios2_BufferManagement;
 	struct bcmgenet_tx_ring *ring = &unit->tx_ring;
-	ObtainSemaphore(&ring->tx_ring_sem);
+	const ULONG eth_len = unlikely(opener->vlanId) ? ETH_HLEN + VLAN_HLEN : ETH_HLEN;
+	const ULONG length = io->ios2_DataLength;
+	const ULONG mss = GENET_TSO_MSS(io);
 
-	KprintfH("[genet] %s: pre: tx_cons_index %ld, tx_prod_index %ld, write_ptr %ld, clean_ptr %ld\n", __func__,
-			 ring->tx_cons_index, ring->tx_prod_index, ring->write_ptr, ring->clean_ptr);
+	/* Check the worst case segment count before copying anything */
+	if (ring->free_bds <= 2 * bcmgenet_tso_segments_max(io))
+		return XMIT_BUSY;
 
-	UBYTE bds_required = (io->ios2_Req.io_Flags & SANA2IOF_RAW) ? 1 : 2;
-	if (unlikely(ring->free_bds <= bds_required))
+	if (ring->tso_buffer == NULL)
 	{
-		KprintfH("[genet] %s: Not enough free BDs\n", __func__);
+		ring->tso_buffer = UnitAllocPooled(unit, GENET_TSO_MAX, GENET_POOL_TSO);
+		if (ring->tso_buffer == NULL)
+			goto ret_error;
+	}
+	if (opener->CopyFromBuff(ring->tso_buffer, io->ios2_Data, length) == 0)
 		goto ret_error;
+
+	UBYTE *ip = ring->tso_buffer;
+	const ULONG ip_len = (ip[0] & 0x0f) * 4;
+	if ((ip[0] >> 4) != 4 || ip_len < 20 || ip[9] != 6 || length < ip_len + 20)
+		goto ret_bad;
+	UBYTE *tcp = ip + ip_len;
+	const ULONG tcp_len = (tcp[12] >> 4) * 4;
+	const ULONG hdr_len = ip_len + tcp_len;
+	if (tcp_len < 20 || length <= hdr_len || hdr_len + mss > ETH_DATA_LEN)
+		goto ret_bad;
+
+	UBYTE *payload = ip + hdr_len;
+	const ULONG payload_len = length - hdr_len;
+	const UWORD segments = (payload_len + mss - 1) / mss;
+
+	/* Header buffers first, so running out leaves the ring untouched */
+	for (UWORD i = 0; i < segments; i++)
+	{
+		struct enet_cb *hdr_cb = bcmgenet_get_txcb(ring, 2 * i);
+		hdr_cb->internal_buffer = bcmgenet_tx_buf_alloc(ring, eth_len + hdr_len, &hdr_cb->buf_class);
+		if (unlikely(hdr_cb->internal_buffer == NULL))
+		{
+			while (i--)
+				bcmgenet_tx_buf_free(ring, bcmgenet_get_txcb(ring, 2 * i));
+			unit->internalStats.tx_no_buffer++;
+			return XMIT_BUSY;
+		}
+	}
+
+	ULONG len = payload_len;
+	CachePreDMA(payload, &len, DMA_ReadFromRAM);
+
+	const ULONG seq = *(ULONG *)&tcp[4];
+	const UWORD id = *(UWORD *)&ip[4];
+	/* Pseudo header without the TCP length, which changes per segment */
+	const ULONG pseudo = csum_add(6, &ip[12], 8);
+
+	for (UWORD i = 0; i < segments; i++)
+	{
+		const ULONG offset = i * mss;
+		const ULONG seg_len = payload_len - offset < mss ? payload_len - offset : mss;
+		struct enet_cb *hdr_cb = bcmgenet_get_txcb(ring, 2 * i);
+		struct enet_cb *data_cb = bcmgenet_get_txcb(ring, 2 * i + 1);
+		UBYTE *h = hdr_cb->internal_buffer;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wstrict-aliasing"
+		*(ULONG *)&h[0] = *(ULONG *)&io->ios2_DstAddr[0];
+		*(UWORD *)&h[4] = *(UWORD *)&io->ios2_DstAddr[4];
+		*(ULONG *)&h[6] = *(ULONG *)&unit->currentMacAddress[0];
+		*(UWORD *)&h[10] = *(UWORD *)&unit->currentMacAddress[4];
+#pragma GCC diagnostic pop
+		if (unlikely(opener->vlanId))
+		{
+			*(UWORD *)&h[12] = ETH_P_8021Q;
+			*(UWORD *)&h[14] = opener->vlanId;
+		}
+		*(UWORD *)&h[eth_len - 2] = 0x0800;
+
+		UBYTE *sip = h + eth_len;
+		UBYTE *stcp = sip + ip_len;
+		CopyMem(ip, sip, hdr_len);
+
+		*(UWORD *)&sip[2] = hdr_len + seg_len;
+		*(UWORD *)&sip[4] = id + i;
+		*(UWORD *)&sip[10] = 0;
+		*(UWORD *)&sip[10] = csum_fold(csum_add(0, sip, ip_len));
+
+		*(ULONG *)&stcp[4] = seq + offset;
+		if (i > 0)
+			stcp[13] &= ~TCP_FLAG_CWR;
+		if (i < segments - 1)
+			stcp[13] &= ~(TCP_FLAG_FIN | TCP_FLAG_PSH);
+		*(UWORD *)&stcp[16] = 0;
+		ULONG sum = csum_add(pseudo + tcp_len + seg_len, stcp, tcp_len);
+		*(UWORD *)&stcp[16] = csum_fold(csum_add(sum, payload + offset, seg_len));
+
+		CaptureFrame(&unit->capture, h, eth_len + hdr_len, payload + offset, seg_len);
+
+		hdr_cb->data_buffer = NULL;
+		hdr_cb->ioReq = NULL;
+		ULONG len_stat = ((eth_len + hdr_len) << DMA_BUFLENGTH_SHIFT) | (GENET_QTAG_MASK << DMA_TX_QTAG_SHIFT);
+		dmadesc_set(hdr_cb->descriptor_address, h, len_stat | DMA_TX_APPEND_CRC | DMA_SOP);
+		len = eth_len + hdr_len;
+		CachePreDMA(h, &len, DMA_ReadFromRAM);
+
+		/* The staging buffer is not a bounce slot, reclaim must not free it */
+		data_cb->internal_buffer = NULL;
+		data_cb->data_buffer = payload + offset;
+		data_cb->ioReq = i == segments - 1 ? io : NULL;
+		len_stat = (seg_len << DMA_BUFLENGTH_SHIFT) | (GENET_QTAG_MASK << DMA_TX_QTAG_SHIFT);
+		dmadesc_set(data_cb->descriptor_address, data_cb->data_buffer, len_stat | DMA_TX_APPEND_CRC | DMA_EOP);
+	}
+
+	ring->tso_io = io;
+	REQUEST_OWNER(io) = NULL;
+
+	ring->write_ptr += 2 * segments;
+	ring->free_bds -= 2 * segments;
+	ring->tx_prod_index += 2 * segments;
+	ring->tx_prod_index &= DMA_P_INDEX_MASK;
+
+	writel(ring->tx_prod_index, (ULONG)unit->genetBase + TDMA_PROD_INDEX);
+	Trace(GENET_TRACE_TX_XMIT, unit->unitNumber, length, (ULONG)io, ring->tx_prod_index);
+
+	unit->internalStats.tx_tso_writes++;
+	unit->internalStats.tx_tso_segments += segments;
+	unit->tx_watchdog_fast_ticks = genetConfig.tx_pending_fast_ticks;
+	return COMMAND_SCHEDULED;
+
+ret_bad:
+	io->ios2_WireError = S2WERR_GENERIC_ERROR;
+	io->ios2_Req.io_Error = S2ERR_BAD_ARGUMENT;
+	return COMMAND_PROCESSED;
+
+ret_error:
+	Trace(GENET_TRACE_TX_DROP, unit->unitNumber, length, (ULONG)io, ring->free_bds);
+	unit->internalStats.tx_dropped++;
+	io->ios2_WireError = S2WERR_BUFF_ERROR;
+	io->ios2_Req.io_Error = S2ERR_NO_RESOURCES;
+	ReportEvents(unit, S2EVENT_BUFF | S2EVENT_TX | S2EVENT_SOFTWARE | S2EVENT_ERROR);
+	return COMMAND_PROCESSED;
+}
+
+/*
+ * GENET_CMD_TSOWRITE, called with tx_ring_sem held. One write at a time owns
+ * the staging buffer, the others wait on tso_wait in order, so the backlog of
+ * ordinary writes behind them keeps moving.
+ */
+static int bcmgenet_xmit_tso(struct IOSana2Req *io, struct GenetUnit *unit)
+{
+	struct bcmgenet_tx_ring *ring = &unit->tx_ring;
+	const ULONG length = io->ios2_DataLength;
+	const ULONG mss = GENET_TSO_MSS(io);
+
+	/* Refused before waiting: bad arguments, or more segments than the ring ever holds. The MSS against the real headers is checked once they are read. */
+	if ((io->ios2_Req.io_Flags & SANA2IOF_RAW) || io->ios2_PacketType != 0x0800 || length < 40 || length > GENET_TSO_MAX ||
+		mss == 0 || mss > ETH_DATA_LEN - 40 || 2 * bcmgenet_tso_segments_max(io) >= TX_DESCS)
+	{
+		io->ios2_WireError = S2WERR_GENERIC_ERROR;
+		io->ios2_Req.io_Error = S2ERR_BAD_ARGUMENT;
+		return COMMAND_PROCESSED;
+	}
+
+	if (ring->tso_io != NULL || ring->tso_wait.mlh_TailPred != (struct MinNode *)&ring->tso_wait)
+	{
+		/* Started by bcmgenet_tx_tso_refill once reclaim frees the staging buffer, AbortIO can take it back until then */
+		QueueRequest(&ring->tso_wait, io);
+		Trace(GENET_TRACE_TX_BACKLOG, unit->unitNumber, length, (ULONG)io, ring->tx_backlog_count);
+		return COMMAND_SCHEDULED;
+	}
+	return bcmgenet_xmit_tso_start(io, unit);
+}
+
+/* Called with tx_ring_sem held and the staging buffer free, starts waiting TSO writes until one owns it */
+static void bcmgenet_tx_tso_refill(struct GenetUnit *unit)
+{
+	struct bcmgenet_tx_ring *ring = &unit->tx_ring;
+	struct IOSana2Req *io;
+
+	while (ring->tso_io == NULL && (io = DequeueRequest(&ring->tso_wait)))
+	{
+		int result = bcmgenet_xmit_tso_start(io, unit);
+		if (result == XMIT_BUSY)
+		{
+			REQUEST_OWNER(io) = &ring->tso_wait;
+			AddHeadMinList(&ring->tso_wait, (struct MinNode *)io);
+			break;
+		}
+		if (result == COMMAND_PROCESSED)
+			ReplyMsg((struct Message *)io);
+	}
+}
+
+/* Called with tx_ring_sem held */
+static int bcmgenet_xmit_ring(struct IOSana2Req *io, struct GenetUnit *unit)
+{
+	struct Opener *opener = io->ios2_BufferManagement;
+	struct bcmgenet_tx_ring *ring = &unit->tx_ring;
+
+	if (unlikely(io->ios2_Req.io_Command == GENET_CMD_TSOWRITE))
+		return bcmgenet_xmit_tso(io, unit);
+
+	const BOOL raw = (io->ios2_Req.io_Flags & SANA2IOF_RAW) != 0;
+	/* Openers bound to a VLAN send tagged frames, the tag goes into the header buffer */
+	const ULONG hdr_len = unlikely(opener->vlanId) ? ETH_HLEN + VLAN_HLEN : ETH_HLEN;
+	UBYTE bds_required = raw ? 1 : 2;
+	if (unlikely(ring->free_bds <= bds_required))
+	{
+		return XMIT_BUSY;
 	}
 
 	if (unlikely(io->ios2_DataLength == 0))
 	{
-		KprintfH("[genet] %s: No data to send\n", __func__);
 		goto ret_error;
 	}
 
-	if (likely((io->ios2_Req.io_Flags & SANA2IOF_RAW) == 0))
+	ULONG copy_len = (io->ios2_DataLength + opener->txPad) & ~opener->txPad;
+	if (unlikely(copy_len > TX_BUF_MAX_LENGTH))
 	{
-		KprintfH("[genet] %s: adding ethernet header\n", __func__);
+		goto ret_error;
+	}
 
-		struct enet_cb *tx_cb_ptr = bcmgenet_get_txcb(ring);
-		UBYTE *ptr = (UBYTE *)tx_cb_ptr->internal_buffer;
-		tx_cb_ptr->data_buffer = NULL;
-		tx_cb_ptr->ioReq = NULL;
+	/* Buffers are taken before any descriptor is touched, so a failure
+	 * below leaves the ring exactly as it was.
+	 */
+	struct enet_cb *hdr_cb_ptr = NULL;
+	if (likely(!raw))
+	{
+		hdr_cb_ptr = bcmgenet_get_txcb(ring, 0);
+		UBYTE *ptr = bcmgenet_tx_buf_alloc(ring, hdr_len, &hdr_cb_ptr->buf_class);
+		if (unlikely(ptr == NULL))
+		{
+			unit->internalStats.tx_no_buffer++;
+			return XMIT_BUSY;
+		}
+		hdr_cb_ptr->internal_buffer = ptr;
+		hdr_cb_ptr->data_buffer = NULL;
+		hdr_cb_ptr->ioReq = NULL;
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wstrict-aliasing"
@@ -131,95 +534,227 @@ int bcmgenet_xmit(struct IOSana2Req *io, struct GenetUnit *unit)
 		*(UWORD *)&ptr[10] = *(UWORD *)&unit->currentMacAddress[4];
 #pragma GCC diagnostic pop
 
-		*(UWORD *)&ptr[12] = io->ios2_PacketType;
-
-		ULONG len_stat = (ETH_HLEN << DMA_BUFLENGTH_SHIFT) | (GENET_QTAG_MASK << DMA_TX_QTAG_SHIFT);
-		/* Note: if we ever change from DMA_TX_APPEND_CRC below we
-		 * will need to restore software padding of "runt" packets
-		 */
-		len_stat |= DMA_TX_APPEND_CRC;
-		len_stat |= DMA_SOP;
-
-		dmadesc_set(tx_cb_ptr->descriptor_address, tx_cb_ptr->internal_buffer, len_stat);
-
-		ULONG len = ETH_HLEN;
-		CachePreDMA(tx_cb_ptr->internal_buffer, &len, DMA_ReadFromRAM);
-
-		/* Decrement total BD count and advance our write pointer */
-		ring->free_bds--;
-		ring->tx_prod_index++;
-		ring->tx_prod_index &= DMA_P_INDEX_MASK;
-		KprintfH("[genet] %s: ETH header sent type: 0x%lx dst addr: %02lx:%02lx:%02lx:%02lx:%02lx:%02lx\n", __func__, io->ios2_PacketType,
-				 io->ios2_DstAddr[0], io->ios2_DstAddr[1], io->ios2_DstAddr[2],
-				 io->ios2_DstAddr[3], io->ios2_DstAddr[4], io->ios2_DstAddr[5]);
+		if (unlikely(opener->vlanId))
+		{
+			*(UWORD *)&ptr[12] = ETH_P_8021Q;
+			*(UWORD *)&ptr[14] = opener->vlanId;
+		}
+		*(UWORD *)&ptr[hdr_len - 2] = io->ios2_PacketType;
 	}
 
 	// Then the body from upstream
-	struct enet_cb *tx_cb_ptr = bcmgenet_get_txcb(ring);
-	tx_cb_ptr->ioReq = io;
-	/* We'll use the ln_Pred pointer to mark it is on the TX ring now and can't be aborted */
-	io->ios2_Req.io_Message.mn_Node.ln_Pred = NULL;
+	struct enet_cb *tx_cb_ptr = bcmgenet_get_txcb(ring, raw ? 0 : 1);
+	tx_cb_ptr->internal_buffer = NULL;
 
 	if (unlikely(opener->DMACopyFromBuff) && (tx_cb_ptr->data_buffer = (APTR)opener->DMACopyFromBuff(io->ios2_Data)) != NULL)
 	{
 		if (unlikely(tx_cb_ptr->data_buffer <= (APTR)0x1FFFFF))
 		{
-			KprintfH("[genet] %s: Cannot use buffers in CHIP memory, falling back to copying.\n", __func__);
 			// opener->DMACopyFromBuff = NULL; // Disable DMA copy
 			goto use_software_copy;
 		}
-		KprintfH("[genet] %s: Using DMA copy from buffer 0x%lx\n", __func__, (ULONG)tx_cb_ptr->data_buffer);
 		unit->internalStats.tx_dma++;
 	}
 	else
 	{
 	use_software_copy:
-		KprintfH("[genet] %s: Using software copy from buffer\n", __func__);
-		if (!opener->CopyFromBuff || opener->CopyFromBuff(tx_cb_ptr->internal_buffer, io->ios2_Data, genetConfig.use_miami_workaround ? ((io->ios2_DataLength + 3) & ~3) : io->ios2_DataLength) == 0)
+		tx_cb_ptr->internal_buffer = bcmgenet_tx_buf_alloc(ring, copy_len, &tx_cb_ptr->buf_class);
+		if (unlikely(tx_cb_ptr->internal_buffer == NULL))
 		{
-			KprintfH("[genet] %s: Failed to copy packet data from buffer\n", __func__);
-			goto ret_error;
+			unit->internalStats.tx_no_buffer++;
+			if (hdr_cb_ptr)
+				bcmgenet_tx_buf_free(ring, hdr_cb_ptr);
+			return XMIT_BUSY;
+		}
+		if (opener->CopyFromBuff(tx_cb_ptr->internal_buffer, io->ios2_Data, copy_len) == 0)
+		{
+			goto ret_release;
 		}
 		tx_cb_ptr->data_buffer = tx_cb_ptr->internal_buffer;
 		unit->internalStats.tx_copy++;
 	}
 
+	CaptureFrame(&unit->capture, hdr_cb_ptr ? hdr_cb_ptr->internal_buffer : NULL, hdr_cb_ptr ? hdr_len : 0,
+				 tx_cb_ptr->data_buffer, io->ios2_DataLength);
+
+	if (unlikely(io->ios2_PacketType == 0x0806) && genetConfig.arp_offload && !raw && !opener->vlanId)
+		ArpLearn(unit, tx_cb_ptr->data_buffer, io->ios2_DataLength);
+
+	if (likely(hdr_cb_ptr != NULL))
+	{
+		ULONG len_stat = (hdr_len << DMA_BUFLENGTH_SHIFT) | (GENET_QTAG_MASK << DMA_TX_QTAG_SHIFT);
+		/* Note: if we ever change from DMA_TX_APPEND_CRC below we
+		 * will need to restore software padding of "runt" packets
+		 */
+		len_stat |= DMA_TX_APPEND_CRC;
+		len_stat |= DMA_SOP;
+
+		dmadesc_set(hdr_cb_ptr->descriptor_address, hdr_cb_ptr->internal_buffer, len_stat);
+
+		ULONG len = hdr_len;
+		CachePreDMA(hdr_cb_ptr->internal_buffer, &len, DMA_ReadFromRAM);
+	}
+
+	tx_cb_ptr->ioReq = io;
+	/* On the TX ring now, not on any list AbortIO could take it from */
+	REQUEST_OWNER(io) = NULL;
+
 	ULONG len_stat = (io->ios2_DataLength << DMA_BUFLENGTH_SHIFT) | (GENET_QTAG_MASK << DMA_TX_QTAG_SHIFT);
 	/* Note: if we ever change from DMA_TX_APPEND_CRC below we
 	 * will need to restore software padding of "runt" packets
 	 */
 	len_stat |= DMA_TX_APPEND_CRC;
-	if (unlikely(io->ios2_Req.io_Flags & SANA2IOF_RAW))
+	if (unlikely(raw))
 	{
 		len_stat |= DMA_SOP;
 	}
 	len_stat |= DMA_EOP;
-	KprintfH("[genet] %s: Setting descriptor address 0x%lx, data buffer 0x%lx, len_stat 0x%lx\n",
-			 __func__, tx_cb_ptr->descriptor_address, tx_cb_ptr->data_buffer, len_stat);
 
 	dmadesc_set(tx_cb_ptr->descriptor_address, tx_cb_ptr->data_buffer, len_stat);
 
 	CachePreDMA(tx_cb_ptr->data_buffer, &io->ios2_DataLength, DMA_ReadFromRAM);
 
 	/* Decrement total BD count and advance our write pointer */
-	ring->free_bds--;
-	ring->tx_prod_index++;
+	ring->write_ptr += bds_required;
+	ring->free_bds -= bds_required;
+	ring->tx_prod_index += bds_required;
 	ring->tx_prod_index &= DMA_P_INDEX_MASK;
 
 	writel(ring->tx_prod_index, (ULONG)unit->genetBase + TDMA_PROD_INDEX);
-	KprintfH("[genet] %s: Transmitting packet, tx_prod_index %ld, free_bds %ld\n",
-			 __func__, ring->tx_prod_index, ring->free_bds);
+	Trace(GENET_TRACE_TX_XMIT, unit->unitNumber, io->ios2_DataLength, (ULONG)io, ring->tx_prod_index);
 
 	unit->tx_watchdog_fast_ticks = genetConfig.tx_pending_fast_ticks; /* ensure a few fast polls */
 
-	ReleaseSemaphore(&ring->tx_ring_sem);
 	return COMMAND_SCHEDULED;
 
+ret_release:
+	bcmgenet_tx_buf_free(ring, tx_cb_ptr);
+	if (hdr_cb_ptr)
+		bcmgenet_tx_buf_free(ring, hdr_cb_ptr);
 ret_error:
+	Trace(GENET_TRACE_TX_DROP, unit->unitNumber, io->ios2_DataLength, (ULONG)io, ring->free_bds);
 	unit->internalStats.tx_dropped++;
 	io->ios2_WireError = S2WERR_BUFF_ERROR;
 	io->ios2_Req.io_Error = S2ERR_NO_RESOURCES;
 	ReportEvents(unit, S2EVENT_BUFF | S2EVENT_TX | S2EVENT_SOFTWARE | S2EVENT_ERROR);
-	ReleaseSemaphore(&ring->tx_ring_sem);
 	return COMMAND_PROCESSED;
 }
+
+int bcmgenet_xmit(struct IOSana2Req *io, struct GenetUnit *unit)
+{
+	struct bcmgenet_tx_ring *ring = &unit->tx_ring;
+	ObtainSemaphore(&ring->tx_ring_sem);
+
+	/* Older writes still waiting go first */
+	int result = XMIT_BUSY;
+	if (likely(ring->tx_backlog_count == 0))
+		result = bcmgenet_xmit_ring(io, unit);
+
+	if (unlikely(result == XMIT_BUSY))
+	{
+		if (ring->tx_backlog_count < genetConfig.tx_backlog)
+		{
+			/* Sent by bcmgenet_tx_backlog_refill once reclaim frees the ring, AbortIO can take it back until then */
+			QueueRequest(&ring->tx_backlog, io);
+			if (++ring->tx_backlog_count > unit->internalStats.tx_backlog_peak)
+				unit->internalStats.tx_backlog_peak = ring->tx_backlog_count;
+			unit->internalStats.tx_backlogged++;
+			Trace(GENET_TRACE_TX_BACKLOG, unit->unitNumber, io->ios2_DataLength, (ULONG)io, ring->tx_backlog_count);
+			result = COMMAND_SCHEDULED;
+		}
+		else
+		{
+			Trace(GENET_TRACE_TX_DROP, unit->unitNumber, io->ios2_DataLength, (ULONG)io, ring->free_bds);
+			unit->internalStats.tx_dropped++;
+			io->ios2_WireError = S2WERR_BUFF_ERROR;
+			io->ios2_Req.io_Error = S2ERR_NO_RESOURCES;
+			ReportEvents(unit, S2EVENT_BUFF | S2EVENT_TX | S2EVENT_SOFTWARE | S2EVENT_ERROR);
+			result = COMMAND_PROCESSED;
+		}
+	}
+
+	bcmgenet_tx_ring_release(unit);
+	return result;
+}
+
+/* A frame of the driver's own, copied into one bounce slot. Nobody waits for it, reclaim only frees the slot. */
+int bcmgenet_xmit_frame(struct GenetUnit *unit, const UBYTE *frame, ULONG length)
+{
+	struct bcmgenet_tx_ring *ring = &unit->tx_ring;
+	int error = S2ERR_NO_RESOURCES;
+
+	ObtainSemaphore(&ring->tx_ring_sem);
+	if (unlikely(unit->state != STATE_ONLINE || ring->free_bds <= 1))
+		goto out;
+
+	struct enet_cb *cb = bcmgenet_get_txcb(ring, 0);
+	cb->internal_buffer = bcmgenet_tx_buf_alloc(ring, length, &cb->buf_class);
+	if (unlikely(cb->internal_buffer == NULL))
+	{
+		unit->internalStats.tx_no_buffer++;
+		goto out;
+	}
+	CopyMem((APTR)frame, cb->internal_buffer, length);
+	cb->data_buffer = cb->internal_buffer;
+	cb->ioReq = NULL;
+	CaptureFrame(&unit->capture, NULL, 0, cb->data_buffer, length);
+
+	ULONG len_stat = (length << DMA_BUFLENGTH_SHIFT) | (GENET_QTAG_MASK << DMA_TX_QTAG_SHIFT);
+	dmadesc_set(cb->descriptor_address, cb->data_buffer, len_stat | DMA_TX_APPEND_CRC | DMA_SOP | DMA_EOP);
+	CachePreDMA(cb->data_buffer, &length, DMA_ReadFromRAM);
+
+	ring->write_ptr++;
+	ring->free_bds--;
+	ring->tx_prod_index = (ring->tx_prod_index + 1) & DMA_P_INDEX_MASK;
+	writel(ring->tx_prod_index, (ULONG)unit->genetBase + TDMA_PROD_INDEX);
+	Trace(GENET_TRACE_TX_XMIT, unit->unitNumber, length, 0, ring->tx_prod_index);
+
+	/* Reclaim only counts packets with a request */
+	unit->stats.PacketsSent++;
+	unit->internalStats.tx_packets++;
+	unit->internalStats.tx_bytes += length;
+	unit->tx_watchdog_fast_ticks = genetConfig.tx_pending_fast_ticks;
+	error = S2ERR_NO_ERROR;
+
+out:
+	bcmgenet_tx_ring_release(unit);
+	return error;
+}
+
+/* Called with tx_ring_sem held, moves waiting writes onto the ring as long as it takes them */
+static void bcmgenet_tx_backlog_refill(struct GenetUnit *unit)
+{
+	struct bcmgenet_tx_ring *ring = &unit->tx_ring;
+	struct IOSana2Req *io;
+
+	while ((io = DequeueRequest(&ring->tx_backlog)))
+	{
+		int result = bcmgenet_xmit_ring(io, unit);
+		if (result == XMIT_BUSY)
+		{
+			REQUEST_OWNER(io) = &ring->tx_backlog;
+			AddHeadMinList(&ring->tx_backlog, (struct MinNode *)io);
+			break;
+		}
+		ring->tx_backlog_count--;
+		if (result == COMMAND_PROCESSED)
+			ReplyMsg((struct Message *)io);
+	}
+}
+
+/* The unit goes offline, nothing waiting will be sent */
+void bcmgenet_tx_backlog_abort(struct GenetUnit *unit)
+{
+	struct bcmgenet_tx_ring *ring = &unit->tx_ring;
+	struct IOSana2Req *io;
+
+	ObtainSemaphore(&ring->tx_ring_sem);
+	while ((io = DequeueRequest(&ring->tx_backlog)) || (io = DequeueRequest(&ring->tso_wait)))
+	{
+		io->ios2_WireError = S2WERR_UNIT_OFFLINE;
+		io->ios2_Req.io_Error = S2ERR_OUTOFSERVICE;
+		ReplyMsg((struct Message *)io);
+	}
+	ring->tx_backlog_count = 0;
+	bcmgenet_tx_ring_release(unit);
+}
@@ -120,39 +120,85 @@ static void bcmgenet_enable_dma(struct GenetUnit *unit)
 	setbits_32((APTR)((ULONG)unit->genetBase + TDMA_REG_BASE + DMA_CTRL), DMA_EN);
 }
 
-int bcmgenet_gmac_eth_recv(struct GenetUnit *unit, UBYTE **packetp)
+/* Invalidate the buffers of count descriptors starting at index, at most two calls as the ring wraps */
+static inline void bcmgenet_rx_invalidate(struct GenetUnit *unit, UWORD index, UWORD count)
 {
+	UWORD first = index & (RX_DESCS - 1);
+	UWORD head = (first + count > RX_DESCS) ? RX_DESCS - first : count;
+
+	ULONG length = head * RX_BUF_LENGTH;
+	CachePostDMA(&unit->rxbuffer[first * RX_BUF_LENGTH], &length, 0);
+	if (head < count)
+	{
+		length = (count - head) * RX_BUF_LENGTH;
+		CachePostDMA(unit->rxbuffer, &length, 0);
+	}
+}
+
+/* Start an RX pass: one producer index read, one cache invalidation for everything it covers.
+ * Returns the number of frames that can be taken with bcmgenet_rx_next.
+ */
+UWORD bcmgenet_rx_begin(struct GenetUnit *unit)
+{
+	struct bcmgenet_rx_ring *ring = &unit->rx_ring;
+	ULONG now = timer_get_us();
 	UWORD rx_prod_index = readl((ULONG)unit->genetBase + RDMA_PROD_INDEX) & DMA_P_INDEX_MASK;
 
-	if (rx_prod_index == unit->rx_ring.rx_cons_index)
-		return EAGAIN;
+	/* Frames that became visible since the last poll completed after it */
+	while (ring->rx_seen_index != rx_prod_index)
+	{
+		ring->rx_control_block[ring->rx_seen_index & 0xff].timestamp = ring->rx_poll_time;
+		ring->rx_seen_index = (ring->rx_seen_index + 1) & DMA_P_INDEX_MASK;
+	}
+	ring->rx_poll_time = now;
+
+	UWORD count = (rx_prod_index - ring->rx_cons_index) & DMA_P_INDEX_MASK;
+	ring->rx_batch_end = rx_prod_index;
+	if (count == 0)
+		return 0;
 
 	//TODO replace it with HW flags
-	if (rx_prod_index - unit->rx_ring.rx_cons_index > RX_DESCS - 1) {
+	if (count > RX_DESCS - 1)
+	{
 		unit->internalStats.rx_overruns++;
+		count = RX_DESCS;
 	}
 
-	KprintfH("[genet] %s: rx_prod_index=%ld, rx_cons_index=%ld\n", __func__, rx_prod_index, unit->rx_ring.rx_cons_index);
+	KprintfH("[genet] %s: rx_prod_index=%ld, rx_cons_index=%ld\n", __func__, rx_prod_index, ring->rx_cons_index);
+	bcmgenet_rx_invalidate(unit, ring->rx_cons_index, count);
+	return count;
+}
 
-	struct enet_cb *rx_cb = &unit->rx_ring.rx_control_block[unit->rx_ring.rx_cons_index & 0xff];
-	APTR desc_base = rx_cb->descriptor_address;
-	ULONG length = readl((ULONG)desc_base + DMA_DESC_LENGTH_STATUS);
-	length = (length >> DMA_BUFLENGTH_SHIFT) & DMA_BUFLENGTH_MASK;
-	APTR addr = rx_cb->internal_buffer;
+/* Next frame of the pass. Only the descriptor status is read, the consumer index is written by bcmgenet_rx_end. */
+int bcmgenet_rx_next(struct GenetUnit *unit, UBYTE **packetp)
+{
+	struct bcmgenet_rx_ring *ring = &unit->rx_ring;
+
+	if (ring->rx_cons_index == ring->rx_batch_end)
+		return EAGAIN;
 
-	CachePostDMA(addr, &length, 0);
+	struct enet_cb *rx_cb = &ring->rx_control_block[ring->rx_cons_index & 0xff];
+	ULONG length = readl((ULONG)rx_cb->descriptor_address + DMA_DESC_LENGTH_STATUS);
+	length = (length >> DMA_BUFLENGTH_SHIFT) & DMA_BUFLENGTH_MASK;
+	ring->rx_frame_time = rx_cb->timestamp;
+	ring->rx_cons_index = (ring->rx_cons_index + 1) & DMA_C_INDEX_MASK;
 
-	*packetp = (UBYTE *)addr + RX_BUF_OFFSET;
+	*packetp = (UBYTE *)rx_cb->internal_buffer + RX_BUF_OFFSET;
 	KprintfH("[genet] %s: packet=%08lx length=%ld\n", __func__, *packetp, length - RX_BUF_OFFSET);
 
 	return length - RX_BUF_OFFSET;
 }
 
-void bcmgenet_gmac_free_pkt(struct GenetUnit *unit)
+/* Hand the buffers of the pass back to the MAC with a single consumer index write */
+void bcmgenet_rx_end(struct GenetUnit *unit)
 {
-	/* Tell the MAC we have consumed that last receive buffer. */
-	unit->rx_ring.rx_cons_index = (unit->rx_ring.rx_cons_index + 1) & DMA_C_INDEX_MASK;
-	writel(unit->rx_ring.rx_cons_index, (ULONG)unit->genetBase + RDMA_CONS_INDEX);
+	struct bcmgenet_rx_ring *ring = &unit->rx_ring;
+
+	if (ring->rx_cons_index != ring->rx_cons_written)
+	{
+		writel(ring->rx_cons_index, (ULONG)unit->genetBase + RDMA_CONS_INDEX);
+		ring->rx_cons_written = ring->rx_cons_index;
+	}
 }
 
 #define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
@@ -210,7 +256,7 @@ static int bcmgenet_init_rx_ring(struct GenetUnit *unit)
 
 	/* Initialize common Rx ring structures */
 	const APTR desc_base = unit->genetBase + GENET_RX_OFF;
-	ring->rx_control_block = AllocPooled(unit->memoryPool, RX_DESCS * sizeof(struct enet_cb));
+	ring->rx_control_block = UnitAllocPooled(unit, RX_DESCS * sizeof(struct enet_cb), GENET_POOL_RX_CB);
 	if (!ring->rx_control_block)
 	{
 		return S2ERR_NO_RESOURCES;
@@ -239,6 +285,10 @@ static int bcmgenet_init_rx_ring(struct GenetUnit *unit)
 	writel(ring->rx_cons_index, (ULONG)unit->genetBase + RDMA_CONS_INDEX);
 	Kprintf("[genet] %s: rx_cons_index=%ld\n", __func__, unit->rx_ring.rx_cons_index);
 	ring->read_ptr = ring->rx_cons_index;
+	ring->rx_seen_index = ring->rx_cons_index;
+	ring->rx_batch_end = ring->rx_cons_index;
+	ring->rx_cons_written = ring->rx_cons_index;
+	ring->rx_poll_time = timer_get_us();
 
 	writel((RX_DESCS << DMA_RING_SIZE_SHIFT) | RX_BUF_LENGTH, unit->genetBase + RDMA_RING_REG_BASE + DMA_RING_BUF_SIZE);
 	writel((DMA_FC_THRESH_LO << DMA_XOFF_THRESHOLD_SHIFT) | DMA_FC_THRESH_HI, unit->genetBase + RDMA_XON_XOFF_THRESH);
@@ -274,11 +324,11 @@ static int bcmgenet_init_tx_ring(struct GenetUnit *unit)
 	Kprintf("[genet] %s: Initializing TX ring\n", __func__);
 	struct bcmgenet_tx_ring *ring = &unit->tx_ring;
 
-	InitSemaphore(&ring->tx_ring_sem);
+	/* tx_ring_sem is set up in UnitOpen, writes may be using it already */
 
 	/* Initialize common TX ring structures */
 	APTR desc_base = unit->genetBase + GENET_TX_OFF;
-	ring->tx_control_block = AllocPooled(unit->memoryPool, TX_DESCS * sizeof(struct enet_cb));
+	ring->tx_control_block = UnitAllocPooled(unit, TX_DESCS * sizeof(struct enet_cb), GENET_POOL_TX_CB);
 	if (!ring->tx_control_block)
 	{
 		return S2ERR_NO_RESOURCES;
@@ -288,9 +338,11 @@ static int bcmgenet_init_tx_ring(struct GenetUnit *unit)
 	for (ULONG i = 0; i < TX_DESCS; i++)
 	{
 		ring->tx_control_block[i].descriptor_address = desc_base + i * DMA_DESC_SIZE;
-		ring->tx_control_block[i].internal_buffer = &unit->txbuffer[i * RX_BUF_LENGTH];
 	}
 
+	/* Bounce buffers are handed out per packet from the TX arena */
+	bcmgenet_tx_buf_init(unit);
+
 	ring->free_bds = TX_DESCS;
 
 	/* Cannot init TDMA_CONS_INDEX to 0, so align TDMA_PROD_INDEX on it instead */
@@ -431,11 +483,11 @@ void bcmgenet_set_rx_mode(struct GenetUnit *unit)
 
 	/*
 	 * Turn on promicuous mode for two scenarios
-	 * 1. SANA2OPF_PROM flag is set
+	 * 1. An opener asked for SANA2OPF_PROM
 	 * 2. The number of filters needed exceeds the number of filters supported by the hardware.
 	 */
 	ULONG reg = readl((ULONG)unit->genetBase + UMAC_CMD);
-	if ((unit->flags & SANA2OPF_PROM) || nfilter > MAX_MDF_FILTER)
+	if (unit->promiscCount || nfilter > MAX_MDF_FILTER)
 	{
 		Kprintf("[genet] %s: Enabling promiscuous mode, nfilter=%ld\n", __func__, nfilter);
 		reg |= CMD_PROMISC;
@@ -646,8 +698,25 @@ void bcmgenet_gmac_eth_stop(struct GenetUnit *unit)
 	/* Disable MAC transmit. TX DMA disabled must be done before this */
 	clrbits_32((APTR)((ULONG)unit->genetBase + UMAC_CMD), CMD_TX_EN);
 	delay_us(1000);
-	/* tx reclaim */
-	bcmgenet_tx_reclaim(unit);
+	/* tx reclaim, only if the ring was ever set up */
+	if (unit->tx_ring.tx_control_block)
+	{
+		bcmgenet_tx_reclaim(unit);
+		bcmgenet_tx_backlog_abort(unit);
+		if (unit->tx_ring.tso_buffer)
+		{
+			UnitFreePooled(unit, unit->tx_ring.tso_buffer, GENET_TSO_MAX, GENET_POOL_TSO);
+			unit->tx_ring.tso_buffer = NULL;
+		}
+		unit->tx_ring.tso_io = NULL;
+		UnitFreePooled(unit, unit->tx_ring.tx_control_block, TX_DESCS * sizeof(struct enet_cb), GENET_POOL_TX_CB);
+		unit->tx_ring.tx_control_block = NULL;
+	}
+	if (unit->rx_ring.rx_control_block)
+	{
+		UnitFreePooled(unit, unit->rx_ring.rx_control_block, RX_DESCS * sizeof(struct enet_cb), GENET_POOL_RX_CB);
+		unit->rx_ring.rx_control_block = NULL;
+	}
 	// /* Really kill the PHY state machine and disconnect from it */
 	// phy_disconnect(dev->phydev);
 
@@ -623,7 +623,7 @@ struct phy_device *phy_create(struct GenetUnit *dev, phy_interface_t interface)
 	Kprintf("[genet] %s: base=0x%lx phyaddr=%ld\n", __func__, dev->genetBase, dev->phyaddr);
 	struct phy_device *phydev;
 
-	phydev = AllocPooled(dev->memoryPool, sizeof(*phydev));
+	phydev = UnitAllocPooled(dev, sizeof(*phydev), GENET_POOL_PHY);
 	if (!phydev)
 	{
 		Kprintf("[genet] %s: Failed to allocate MDIO bus\n", __func__);
@@ -655,7 +655,7 @@ struct phy_device *phy_create(struct GenetUnit *dev, phy_interface_t interface)
 		}
 	}
 
-	FreePooled(dev->memoryPool, phydev, sizeof(*phydev));
+	UnitFreePooled(dev, phydev, sizeof(*phydev), GENET_POOL_PHY);
 	Kprintf("[genet] %s: Could not get PHY\n", __func__);
 	return NULL;
 }
@@ -663,5 +663,5 @@ struct phy_device *phy_create(struct GenetUnit *dev, phy_interface_t interface)
 void phy_destroy(struct phy_device *phydev)
 {
 	Kprintf("[genet] %s: phy=%ld\n", __func__, phydev->addr);
-	FreePooled(phydev->unit->memoryPool, phydev, sizeof(*phydev));
+	UnitFreePooled(phydev->unit, phydev, sizeof(*phydev), GENET_POOL_PHY);
 }
\ No newline at end of file
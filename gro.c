@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: MPL-2.0 OR GPL-2.0+
+#ifdef __INTELLISENSE__
+#include <clib/exec_protos.h>
+#else
+#include <proto/exec.h>
+#endif
+
+#include <stddef.h>
+
+#include <device.h>
+#include <compat.h>
+#include <gro.h>
+#include <debug.h>
+
+#define GRO_IP ETH_HLEN        /* IPv4 header, options are never merged */
+#define GRO_TCP (ETH_HLEN + 20) /* TCP header */
+
+#define TCP_FLAG_PSH 0x08
+#define TCP_FLAG_ACK 0x10
+
+/* FillRequest may round the copy up to a longword, see USE_MIAMI_WORKAROUND */
+#define GRO_SLACK 4
+
+/* No libc here, and everything compared is a whole number of longwords */
+static inline BOOL SameLongs(const UBYTE *a, const UBYTE *b, ULONG len)
+{
+    for (ULONG i = 0; i < len; i += 4)
+        if (*(const ULONG *)&a[i] != *(const ULONG *)&b[i])
+            return FALSE;
+    return TRUE;
+}
+
+static ULONG GroSize(ULONG maxLength)
+{
+    return offsetof(struct GroContext, frame) + ETH_HLEN + maxLength + GRO_SLACK;
+}
+
+/* Unit task only, like ReceiveFrame and GroFlushAll, so no merge is pending here */
+int GroSet(struct GenetUnit *unit, struct Opener *opener, ULONG maxLength)
+{
+    struct GroContext *g = NULL;
+
+    if (maxLength > GENET_GRO_MAX)
+        return S2ERR_BAD_ARGUMENT;
+
+    if (maxLength)
+    {
+        g = UnitAllocPooled(unit, GroSize(maxLength), GENET_POOL_GRO);
+        if (g == NULL)
+            return S2ERR_NO_RESOURCES;
+        g->size = GroSize(maxLength);
+        g->maxLength = maxLength;
+        g->io = NULL;
+    }
+
+    GroFree(unit, opener);
+    opener->gro = g;
+    if (g)
+        unit->groCount++;
+    return S2ERR_NO_ERROR;
+}
+
+void GroFree(struct GenetUnit *unit, struct Opener *opener)
+{
+    if (opener->gro)
+    {
+        UnitFreePooled(unit, opener->gro, opener->gro->size, GENET_POOL_GRO);
+        opener->gro = NULL;
+        unit->groCount--;
+    }
+}
+
+/*
+ * TRUE for a unicast IPv4/TCP data segment without options in the IP header,
+ * not fragmented, with only ACK and maybe PSH set and both checksums good. A
+ * merged frame gets a fresh checksum, so a bad segment must not get into one.
+ */
+BOOL GroParse(const struct GroContext *g, const UBYTE *packet, ULONG length, struct GroSegment *seg)
+{
+    const UBYTE *ip = &packet[GRO_IP];
+    const UBYTE *tcp = &packet[GRO_TCP];
+
+    if (length < GRO_TCP + 20 || (packet[0] & 0x01) || ip[0] != 0x45 || ip[9] != 6 || (*(UWORD *)&ip[6] & 0x3fff))
+        return FALSE;
+
+    ULONG ipLength = *(UWORD *)&ip[2];
+    ULONG tcpLength = (tcp[12] >> 4) * 4;
+    if (ipLength > length - ETH_HLEN || ipLength > g->maxLength || tcpLength < 20 || ipLength <= 20 + tcpLength)
+        return FALSE;
+    if ((tcp[13] & ~TCP_FLAG_PSH) != TCP_FLAG_ACK)
+        return FALSE;
+    if (csum_fold(csum_add(0, ip, 20)) != 0)
+        return FALSE;
+
+    seg->tcp = tcp;
+    seg->ipLength = ipLength;
+    seg->tcpLength = tcpLength;
+    seg->payload = ipLength - 20 - tcpLength;
+    seg->payloadSum = csum_add(0, tcp + tcpLength, seg->payload);
+
+    ULONG sum = csum_add(6 + ipLength - 20, &ip[12], 8);
+    sum = csum_add(sum, tcp, tcpLength);
+    return csum_fold(sum + seg->payloadSum) == 0;
+}
+
+/* TRUE if the segment continues the pending merge, which then has its payload appended */
+BOOL GroMerge(struct GroContext *g, const UBYTE *packet, const struct GroSegment *seg)
+{
+    const UBYTE *ip = &packet[GRO_IP];
+    UBYTE *mip = &g->frame[GRO_IP];
+    UBYTE *mtcp = &g->frame[GRO_TCP];
+    const ULONG merged = g->length - GRO_TCP - seg->tcpLength;
+
+    /* Same MACs, TOS, DF, TTL, addresses, ports, acknowledgment and TCP options */
+    if (*(ULONG *)&seg->tcp[4] != g->nextSeq || ((mtcp[12] >> 4) * 4) != seg->tcpLength ||
+        (mtcp[13] & TCP_FLAG_PSH) || (merged & 1) || merged + seg->payload + 20 + seg->tcpLength > g->maxLength)
+        return FALSE;
+    if (!SameLongs(packet, g->frame, 12) || ip[1] != mip[1] || *(UWORD *)&ip[6] != *(UWORD *)&mip[6] || ip[8] != mip[8] ||
+        !SameLongs(&ip[12], &mip[12], 8) || *(ULONG *)&seg->tcp[0] != *(ULONG *)&mtcp[0] ||
+        *(ULONG *)&seg->tcp[8] != *(ULONG *)&mtcp[8] || !SameLongs(&seg->tcp[20], &mtcp[20], seg->tcpLength - 20))
+        return FALSE;
+
+    CopyMem((APTR)(seg->tcp + seg->tcpLength), &g->frame[g->length], seg->payload);
+    g->length += seg->payload;
+    g->nextSeq += seg->payload;
+    g->payloadSum += seg->payloadSum;
+    g->segments++;
+    /* The latest window, PSH from the last segment */
+    *(UWORD *)&mtcp[14] = *(UWORD *)&seg->tcp[14];
+    mtcp[13] |= seg->tcp[13] & TCP_FLAG_PSH;
+    return TRUE;
+}
+
+void GroStart(struct GroContext *g, struct IOSana2Req *io, const UBYTE *packet, const struct GroSegment *seg)
+{
+    g->io = io;
+    g->length = ETH_HLEN + seg->ipLength;
+    g->nextSeq = *(ULONG *)&seg->tcp[4] + seg->payload;
+    g->payloadSum = seg->payloadSum;
+    g->segments = 1;
+    CopyMem((APTR)packet, g->frame, g->length);
+}
+
+/* Fixes up the lengths and checksums once more than one segment went in, the caller delivers frame[] to io */
+void GroFinish(struct GroContext *g)
+{
+    UBYTE *ip = &g->frame[GRO_IP];
+    UBYTE *tcp = &g->frame[GRO_TCP];
+    const ULONG ipLength = g->length - ETH_HLEN;
+    const ULONG tcpLength = (tcp[12] >> 4) * 4;
+
+    if (g->segments == 1)
+        return;
+
+    *(UWORD *)&ip[2] = ipLength;
+    *(UWORD *)&ip[10] = 0;
+    *(UWORD *)&ip[10] = csum_fold(csum_add(0, ip, 20));
+
+    *(UWORD *)&tcp[16] = 0;
+    ULONG sum = csum_add(6 + ipLength - 20, &ip[12], 8);
+    sum = csum_add(sum, tcp, tcpLength);
+    *(UWORD *)&tcp[16] = csum_fold(sum + g->payloadSum);
+}
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: MPL-2.0 OR GPL-2.0+
+#ifndef _ARP_H
+#define _ARP_H
+
+#include <exec/types.h>
+#include <devices/genet.h>
+
+/*
+ * ARP offload. ARP requests for one of the unit's own IPv4 addresses are
+ * answered from the unit task and never reach the stack. Addresses come from
+ * GENET_CMD_SETARP, and with ARP_OFFLOAD from the ARP packets the stack sends.
+ * Entries are written under the TX ring lock and read without it, each one is
+ * a single longword store.
+ */
+
+#define ARP_LEARNED_SECONDS 600 /* A learned address is dropped after this long without an ARP from it */
+#define ARP_TTL_SET 0xffff      /* Set by GENET_CMD_SETARP, never expires */
+
+struct ArpOffload
+{
+    ULONG addr[GENET_ARP_MAX]; /* 0 for a free entry */
+    UWORD ttl[GENET_ARP_MAX];  /* Seconds a learned address has left, counted down by ArpExpire, or ARP_TTL_SET */
+    UWORD count;               /* Entries ever used, lookups stop there */
+};
+
+struct GenetUnit;
+
+int ArpSet(struct GenetUnit *unit, const ULONG *addrs, ULONG count);
+void ArpLearn(struct GenetUnit *unit, const UBYTE *arp, ULONG length);
+void ArpExpire(struct GenetUnit *unit, UWORD seconds);
+BOOL ArpAnswer(struct GenetUnit *unit, const UBYTE *packet, ULONG length);
+
+#endif /* _ARP_H */
@@ -184,7 +184,22 @@
 
 #define RX_BUF_LENGTH 2048
 #define RX_TOTAL_BUFSIZE (RX_BUF_LENGTH * RX_DESCS)
-#define TX_TOTAL_BUFSIZE (RX_BUF_LENGTH * TX_DESCS)
+
+/* TX bounce buffer arena. Slots of all size classes are carved out of one
+ * DMA aligned region, smallest class first, so Ethernet headers and short
+ * frames (ACKs, ARP) share cache lines instead of owning a 2 KB slot each.
+ * A request that finds its class empty falls back to the next larger one.
+ * RAW writes take a single descriptor, so the large class has a slot for
+ * every descriptor the ring can hand out. Its slots hold the largest frame
+ * a write can carry, a tagged raw frame plus the Miami round up, and no
+ * more: 1536 bytes keeps them DMA aligned and the arena (481,792 bytes)
+ * below one 2 KB buffer per descriptor.
+ */
+#define TX_BUF_CLASSES 4
+#define TX_BUF_CLASS_SIZES {32, 64, 512, 1536}
+#define TX_BUF_CLASS_COUNTS {TX_DESCS, TX_DESCS, TX_DESCS / 2, TX_DESCS - 1}
+#define TX_BUF_MAX_LENGTH 1536
+#define TX_TOTAL_BUFSIZE ((32 + 64) * TX_DESCS + 512 * (TX_DESCS / 2) + TX_BUF_MAX_LENGTH * (TX_DESCS - 1))
 #define RX_BUF_OFFSET 2
 
 /* Rx Specific Dma descriptor bits */
@@ -11,11 +11,18 @@ int bcmgenet_set_coalesce(struct GenetUnit *unit, ULONG tx_max_coalesced_frames,
 void bcmgenet_set_rx_mode(struct GenetUnit *unit); /* Updates PROMISC flag and sets up MDF if possible */
 
 /* RX functions */
-int bcmgenet_gmac_eth_recv(struct GenetUnit *unit, UBYTE **packetp);
-void bcmgenet_gmac_free_pkt(struct GenetUnit *unit);
+UWORD bcmgenet_rx_begin(struct GenetUnit *unit);
+int bcmgenet_rx_next(struct GenetUnit *unit, UBYTE **packetp);
+void bcmgenet_rx_end(struct GenetUnit *unit);
 
 /* TX functions */
+void bcmgenet_tx_buf_init(struct GenetUnit *unit);
 int bcmgenet_xmit(struct IOSana2Req *io, struct GenetUnit *unit);
-void bcmgenet_tx_reclaim(struct GenetUnit *unit);
+int bcmgenet_xmit_frame(struct GenetUnit *unit, const UBYTE *frame, ULONG length);
+void bcmgenet_tx_submit(struct GenetUnit *unit, struct IOSana2Req *io);
+void bcmgenet_tx_submit_drain(struct GenetUnit *unit);
+void bcmgenet_tx_ring_release(struct GenetUnit *unit); /* ReleaseSemaphore(tx_ring_sem), then drain */
+UWORD bcmgenet_tx_reclaim(struct GenetUnit *unit); /* Returns packets completed */
+void bcmgenet_tx_backlog_abort(struct GenetUnit *unit);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: MPL-2.0 OR GPL-2.0+
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+#include <exec/types.h>
+#include <devices/genet.h>
+#include <compat.h>
+
+/*
+ * Per-unit packet capture. While on, the first snapLen bytes of every frame
+ * received (ReceiveFrame) and sent (bcmgenet_xmit) are copied into a fixed
+ * ring of slots; when the ring is full frames are counted as dropped instead.
+ * GENET_CMD_GETCAPTURE drains the ring as a pcap stream.
+ */
+
+#define CAPTURE_SLOTS 256 /* Must be a power of two */
+
+struct CaptureSlot
+{
+    ULONG timestamp;
+    UWORD length;   /* Frame length on the wire */
+    UWORD captured; /* Bytes in data[], 0 until the writer is done with the slot */
+    UBYTE data[GENET_CAPTURE_SNAP_MAX];
+};
+
+struct GenetCapture
+{
+    struct CaptureSlot *slots; /* NULL while capture is off */
+    UWORD snapLen;
+    ULONG head; /* Slots claimed by writers */
+    ULONG tail; /* Slots handed out by GENET_CMD_GETCAPTURE */
+    ULONG captured;
+    ULONG dropped;
+};
+
+struct GenetUnit;
+
+int CaptureStart(struct GenetUnit *unit, ULONG snapLen);
+void CaptureStop(struct GenetUnit *unit);
+void CaptureRecord(struct GenetCapture *c, const UBYTE *header, ULONG headerLength, const UBYTE *data, ULONG dataLength);
+void CaptureDump(struct GenetCapture *c, struct GenetCaptureDump *dump, ULONG size);
+
+/* Frame split in two parts as the TX path has it, header may be NULL */
+static inline void CaptureFrame(struct GenetCapture *c, const UBYTE *header, ULONG headerLength, const UBYTE *data, ULONG dataLength)
+{
+    if (likely(c->slots == NULL))
+        return;
+    CaptureRecord(c, header, headerLength, data, dataLength);
+}
+
+#endif /* _CAPTURE_H */
@@ -6,17 +6,26 @@
 
 inline ULONG LE32(ULONG x) { return __builtin_bswap32(x); }
 
+/* System timer registers, resolved by DevTreeParse */
+extern APTR SystemTimerBase;
+
+/* Free running 1 MHz system timer (low word) */
+inline ULONG timer_get_us()
+{
+    return LE32(((volatile ULONG *)SystemTimerBase)[1]);
+}
+
 inline void delay_us(ULONG us)
 {
-    ULONG timer = LE32(*(volatile ULONG *)0xf2003004); // TODO get from device tree
+    ULONG timer = timer_get_us();
     ULONG end = timer + us;
 
     if (end < timer)
     {
-        while (end < LE32(*(volatile ULONG *)0xf2003004))
+        while (end < timer_get_us())
             asm volatile("nop");
     }
-    while (end > LE32(*(volatile ULONG *)0xf2003004))
+    while (end > timer_get_us())
         asm volatile("nop");
 }
 
@@ -58,6 +67,24 @@ static inline void out_le32(volatile ULONG *addr, ULONG val)
     // asm volatile("nop");
 }
 
+/* Internet checksum: ones' complement sum of big endian words, not folded */
+static inline ULONG csum_add(ULONG sum, const UBYTE *data, ULONG len)
+{
+    const UWORD *w = (const UWORD *)data;
+    for (; len > 1; len -= 2)
+        sum += *w++;
+    if (len)
+        sum += *(const UBYTE *)w << 8;
+    return sum;
+}
+
+static inline UWORD csum_fold(ULONG sum)
+{
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return ~sum;
+}
+
 #define clrbits_32(addr, clear) clrbits(le32, addr, clear)
 #define setbits_32(addr, set) setbits(le32, addr, set)
 #define clrsetbits_32(addr, clear, set) clrsetbits(le32, addr, clear, set)
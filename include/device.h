@@ -11,22 +11,34 @@
 #include <exec/types.h>
 #include <exec/semaphores.h>
 #include <devices/sana2.h>
+#include <devices/genet.h>
+#include <capture.h>
+#include <filter.h>
+#include <gro.h>
+#include <arp.h>
 
 #include <phy/phy.h>
 #include <bcmgenet.h>
 #include <runtime_config.h>
+#include <bcmgenet-regs.h>
 
 #define LIB_MIN_VERSION 39 /* we use memory pools */
 
 #define ETH_HLEN 14		  /* Total octets in header.				*/
 #define VLAN_HLEN 4		  /* The additional bytes required by VLAN	*/
 						  /* (in addition to the Ethernet header)	*/
+#define ETH_P_8021Q 0x8100 /* 802.1Q VLAN tagged frame				*/
+#define VLAN_VID_MASK 0x0fff /* VLAN identifier bits of the TCI		*/
 #define ETH_FCS_LEN 4	  /* Octets in the FCS             			*/
 #define ETH_DATA_LEN 1500 /* Max. octets in payload					*/
 
 #define ARCH_DMA_MINALIGN 64 /* Minimum DMA alignment. That is in bytes. */
 #define ARCH_DMA_MINALIGN_MASK (ARCH_DMA_MINALIGN - 1)
 
+/* Hot blocks of GenetUnit start on a line of this size, two 68040 lines and the L1 sector Emu68 fetches */
+#define UNIT_CACHELINE 32
+#define UNIT_CACHELINE_ALIGNED __attribute__((aligned(UNIT_CACHELINE)))
+
 #define COMMAND_PROCESSED 1
 #define COMMAND_SCHEDULED 0
 
@@ -59,6 +71,25 @@ typedef enum
 	STATE_OFFLINE
 } UnitState;
 
+#define HOLD_SLOT_SIZE 1536
+
+struct HoldSlot
+{
+	ULONG timestamp;
+	UWORD length; /* 0 once a read took the frame */
+	UWORD packetType;
+	UBYTE data[HOLD_SLOT_SIZE];
+};
+
+/* Ring of frames an opener had no read posted for, served by the next CMD_READ of their type */
+struct HoldQueue
+{
+	UWORD size;	 /* Slots, RX_HOLD_FRAMES */
+	UWORD head;	 /* Oldest slot */
+	UWORD count; /* Slots from head on in use, taken ones included */
+	struct HoldSlot slots[];
+};
+
 struct Opener
 {
 	struct MinNode node;
@@ -71,6 +102,11 @@ struct Opener
 	struct MinList arpQueue;   /* For 0x0806 */
 
 	struct SignalSemaphore openerSemaphore;
+	BOOL promiscuous; /* Opened with SANA2OPF_PROM, every read takes any frame */
+	UWORD vlanId;	  /* Set by GENET_CMD_SETVLAN: frames of this 802.1Q VLAN only, 0 for untagged */
+	struct PacketFilter *filter; /* Set by GENET_CMD_SETFILTER, checked before any read is taken */
+	struct HoldQueue *hold;		 /* IPv4/ARP frames that found no read posted, NULL if RX_HOLD_FRAMES is 0 */
+	struct GroContext *gro;		 /* Set by GENET_CMD_SETGRO, TCP segments are merged for this opener */
 
 	/* for CMD_READ,
 	 * BOOL PacketFilter(struct Hook* packetFilter asm("a0"), struct IOSana2Req* asm("a2"), APTR asm("a1"));
@@ -84,6 +120,17 @@ struct Opener
 	BOOL (*CopyFromBuff)(APTR to asm("a0"), APTR from asm("a1"), ULONG len asm("d0"));
 	APTR (*DMACopyToBuff)(APTR cookie asm("a0"));
 	APTR (*DMACopyFromBuff)(APTR cookie asm("a0"));
+
+	/* Picked once by SetupOpenerDelivery, indexed by SANA2IOF_RAW of the read */
+	BOOL (*fill[2])(struct IOSana2Req *io, UBYTE *packet, ULONG packetLength);
+	ULONG txPad; /* Writes are copied in (length + txPad) & ~txPad bytes, 3 for USE_MIAMI_WORKAROUND */
+};
+
+/* Token bucket of one storm control class */
+struct RxLimiter
+{
+	ULONG tokens; /* Frame-microseconds, a frame costs 1000000 */
+	ULONG last;	  /* timer_get_us() of the last frame of the class */
 };
 
 struct MulticastRange
@@ -94,23 +141,50 @@ struct MulticastRange
 	uint64_t upperBound; /* Inclusive */
 };
 
+struct tx_buf_class
+{
+	APTR free_list; /* Free slots, linked through their first longword */
+	ULONG size;		/* Slot size in bytes */
+};
+
+/* Fields used for every write and every reclaimed descriptor come first, then the lock, then the rarely used lists */
 struct bcmgenet_tx_ring
 {
 	struct enet_cb *tx_control_block; /* tx ring buffer control block*/
-	UBYTE clean_ptr;				  /* Tx ring clean pointer */
-	UWORD tx_cons_index;			  /* last consumer index of each ring*/
 	UWORD free_bds;					  /* # of free bds for each ring */
-	UBYTE write_ptr;				  /* Tx ring write pointer SW copy */
 	UWORD tx_prod_index;			  /* Tx ring producer index SW copy */
+	UWORD tx_cons_index;			  /* last consumer index of each ring*/
+	UBYTE write_ptr;				  /* Tx ring write pointer SW copy */
+	UBYTE clean_ptr;				  /* Tx ring clean pointer */
+	struct IOSana2Req *tx_submit;	  /* Lock-free LIFO of writes waiting for the ring, see bcmgenet_tx_submit */
+	UBYTE tx_draining;				  /* Submissions are being sent by the ring owner */
+	UWORD tx_backlog_count;
+	UWORD tx_done_count;
+	struct IOSana2Req *tso_io; /* Write using tso_buffer until reclaimed */
+
+	struct tx_buf_class buf_class[TX_BUF_CLASSES]; /* bounce buffer arena */
 
 	struct SignalSemaphore tx_ring_sem;
+
+	struct MinList tx_backlog; /* Writes waiting for descriptors or bounce buffers (TX_BACKLOG) */
+	UBYTE *tso_buffer;		   /* GENET_CMD_TSOWRITE payload, DMA'd from directly */
+	struct MinList tso_wait;   /* GENET_CMD_TSOWRITE requests waiting for tso_buffer */
+	struct MinList tx_done;	   /* Completed writes waiting for a batched reply (TX_REPLY_BATCH) */
+	ULONG tx_done_time;		   /* timer_get_us() when the oldest entry was completed */
 };
 
+/* Per frame fields first, the rest is touched once per poll or at setup */
 struct bcmgenet_rx_ring
 {
 	struct enet_cb *rx_control_block; /* Rx ring buffer control block */
 	UWORD rx_cons_index;			  /* Rx last consumer index */
+	UWORD rx_batch_end;				  /* Producer index read by bcmgenet_rx_begin */
 	UBYTE read_ptr;					  /* Rx ring read pointer */
+	ULONG rx_frame_time;			  /* Arrival bound of the frame being delivered */
+	struct MinList rx_done;			  /* Filled reads replied after each RX batch (RX_REPLY_BATCH) */
+	UWORD rx_seen_index;			  /* Producer index at the last poll */
+	UWORD rx_cons_written;			  /* Consumer index last written to the MAC */
+	ULONG rx_poll_time;				  /* timer_get_us() at the last poll */
 	ULONG rx_max_coalesced_frames;
 	ULONG rx_coalesce_usecs;
 };
@@ -121,6 +195,8 @@ struct enet_cb
 	APTR descriptor_address;
 	APTR internal_buffer; /* Used when data needs to be copied from IP stack */
 	APTR data_buffer;
+	UBYTE buf_class;	  /* TX arena size class of internal_buffer */
+	ULONG timestamp;	  /* RX: last poll before the frame was seen */
 };
 
 struct internal_stats
@@ -129,7 +205,14 @@ struct internal_stats
 	ULONG rx_bytes;
 	ULONG rx_dropped;
 	ULONG rx_arp_ip_dropped;
+	ULONG rx_held;		   /* Kept on an opener's hold queue */
+	ULONG rx_hold_expired; /* ... and dropped after RX_HOLD_US */
+	ULONG rx_gro_merged;   /* Segments appended to an earlier one */
+	ULONG rx_gro_flushes;  /* Merged frames delivered */
+	ULONG rx_arp_answered; /* ARP requests answered by the driver */
+	ULONG rx_limited[RX_LIMIT_CLASSES]; /* Dropped by storm control */
 	ULONG rx_overruns;
+	ULONG rx_reply_batches;
 	// ULONG rx_crc_errors;
 	// ULONG rx_over_errors;
 	// ULONG rx_frame_errors;
@@ -140,27 +223,89 @@ struct internal_stats
 	ULONG tx_dma;
 	ULONG tx_copy;
 	ULONG tx_dropped;
+	ULONG tx_no_buffer;
+	ULONG tx_backlogged;	 /* Writes that had to wait for the ring */
+	ULONG tx_backlog_peak; /* Most writes waiting at once */
+	ULONG tx_tso_writes;
+	ULONG tx_tso_segments;
+	ULONG tx_reply_batches;
+};
+
+/* Software loopback unit: writes are received back through this ring instead of the MAC */
+#define LOOPBACK_SLOTS 128 /* Power of two */
+#define LOOPBACK_SLOT_SIZE 1536
+
+struct loopback_ring
+{
+	UBYTE *buffer; /* LOOPBACK_SLOTS * LOOPBACK_SLOT_SIZE, allocated while online */
+	UWORD length[LOOPBACK_SLOTS];
+	ULONG timestamp[LOOPBACK_SLOTS];
+	UWORD prod_index; /* Advanced by the writer, under the TX ring lock */
+	UWORD cons_index; /* Advanced by the unit task */
 };
 
+/* GPIO pin setup, taken from the pinctrl groups of the devicetree node */
+#define GENET_MAX_UNITS 4
+#define GENET_MAX_PINS 16
+
+struct GenetPin
+{
+	UBYTE pin;
+	UBYTE function; /* tGpioAlternativeFunction */
+	UBYTE pull;		/* tGpioPull */
+};
+
+/*
+ * Allocated UNIT_CACHELINE aligned by openLib. The state every frame touches
+ * is packed into three line aligned blocks, RX, TX and the counters both
+ * update, so a packet pulls in a few lines instead of one per field.
+ * Configuration and setup state follows them.
+ */
 struct GenetUnit
 {
 	struct Unit unit;
-	APTR memoryPool;
+	APTR allocation; /* What AllocMem returned, the unit is rounded up from it */
 
-	/* config */
+	/* RX hot state, ReceiveFrame and the RX ring */
+	APTR genetBase UNIT_CACHELINE_ALIGNED;
+	UnitState state;
 	LONG unitNumber;
-	LONG flags;
 	UBYTE currentMacAddress[6];
+	BOOL mdfEnabled; /* Multicast filter enabled */
+	BOOL loopback;	 /* No hardware, see unit_loopback.c */
+	UWORD promiscCount;
+	UWORD groCount; /* Openers with GENET_CMD_SETGRO on, GroFlushAll has nothing to do while 0 */
+	struct MinList openers;
+	UBYTE *rxbuffer;
+	struct bcmgenet_rx_ring rx_ring;
 
-	/* unit/task state */
-	UnitState state;
-	struct Task *task;
-	struct Sana2DeviceStats stats;
+	/* TX hot state */
+	struct bcmgenet_tx_ring tx_ring UNIT_CACHELINE_ALIGNED;
+	UBYTE *txbuffer;
+	UWORD tx_watchdog_fast_ticks; /* remaining fast polls while data on TX ring */
+
+	/* Counters and the capture switch, both directions */
+	struct Sana2DeviceStats stats UNIT_CACHELINE_ALIGNED;
 	struct internal_stats internalStats;
-	struct MinList openers;
+	struct GenetCapture capture;
+	struct GenetLatencyStats latency;
+
+	/* Everything below is per wakeup, per command or setup only */
+	struct GenetWakeupStats wakeups UNIT_CACHELINE_ALIGNED;
+	struct RxLimiter rxLimit[RX_LIMIT_CLASSES];
+	struct ArpOffload arp;
+	struct MinList promiscOpeners; /* Kept apart so normal delivery never looks at them */
 	struct MinList multicastRanges;
 	ULONG multicastCount;
-	BOOL mdfEnabled; /* Multicast filter enabled */
+
+	/* config */
+	LONG flags;
+	APTR memoryPool;
+	struct GenetPoolStats poolStats; /* memoryPool accounting, see UnitAllocPooled */
+
+	/* unit/task state */
+	struct Task *task;
+	char taskName[16];
 
 	/* Opener management (message-based modifications) */
 	struct MsgPort *openerPort; /* created in unit task */
@@ -168,26 +313,21 @@ struct GenetUnit
 	/* Device tree */
 	CONST_STRPTR compatible;
 	const UBYTE *localMacAddress;
-	APTR genetBase;
 	APTR gpioBase;
+	struct GenetPin pins[GENET_MAX_PINS]; /* GPIO setup for MDIO and RGMII */
+	UBYTE pinCount;
 
 	/* PHY */
 	phy_interface_t phy_interface;
 	int phyaddr;
 	struct phy_device *phydev;
 
-	/* MAC layer */
-	/* RX */
-	struct bcmgenet_rx_ring rx_ring;
+	/* MAC layer buffers as allocated */
 	UBYTE *rxbuffer_not_aligned;
-	UBYTE *rxbuffer;
-
-	/* TX */
-	struct bcmgenet_tx_ring tx_ring;
 	UBYTE *txbuffer_not_aligned;
-	UBYTE *txbuffer;
 
-	UWORD tx_watchdog_fast_ticks;/* remaining fast polls while data on TX ring */
+	/* Loopback */
+	struct loopback_ring lb_ring;
 };
 
 /* Opener management commands */
@@ -205,8 +345,8 @@ struct GenetDevice
 	struct Device device;
 	ULONG segList;
 
-	// For now, we'll just assume there can be only one unit
-	struct GenetUnit *unit;
+	/* Allocated on first open, unit N is the devicetree's ethernetN */
+	struct GenetUnit *units[GENET_MAX_UNITS];
 };
 
 /* Unit interface */
@@ -219,8 +359,49 @@ int UnitConfigure(struct GenetUnit *unit);
 int UnitOnline(struct GenetUnit *unit);
 void UnitOffline(struct GenetUnit *unit);
 int UnitClose(struct GenetUnit *unit, struct Opener *opener);
+void UnitAddOpener(struct GenetUnit *unit, struct Opener *opener);
+void UnitRemoveOpener(struct GenetUnit *unit, struct Opener *opener);
+
+void LoopbackInit(struct GenetUnit *unit);
+int LoopbackStart(struct GenetUnit *unit);
+void LoopbackStop(struct GenetUnit *unit);
+int LoopbackXmit(struct IOSana2Req *io, struct GenetUnit *unit);
+UWORD LoopbackReceive(struct GenetUnit *unit, BOOL *delivered);
+
+APTR UnitAllocPooled(struct GenetUnit *unit, ULONG size, UBYTE site);
+void UnitFreePooled(struct GenetUnit *unit, APTR memory, ULONG size, UBYTE site);
+
+/* Bucket of a log2 histogram: 0 -> 0, [2^(n-1), 2^n) -> n, clamped to the last bucket */
+static inline UBYTE Log2Bucket(ULONG value, UBYTE buckets)
+{
+	UBYTE bucket = value ? 32 - __builtin_clz(value) : 0;
+	return bucket < buckets ? bucket : buckets - 1;
+}
+
+/* Add one sample to a log2 latency histogram */
+static inline void LatencyRecord(struct GenetLatencyHistogram *h, ULONG us)
+{
+	h->Bucket[Log2Bucket(us, GENET_LATENCY_BUCKETS)]++;
+	h->Count++;
+	if (us > h->MaxUs)
+		h->MaxUs = us;
+}
+
+static inline void CountRecord(struct GenetCountHistogram *h, ULONG count)
+{
+	h->Bucket[Log2Bucket(count, GENET_COUNT_BUCKETS)]++;
+	h->Count++;
+	if (count > h->Max)
+		h->Max = count;
+}
 
 BOOL ReceiveFrame(struct GenetUnit *unit, UBYTE *packet, ULONG packetLength);
+BOOL ReadHeldFrame(struct IOSana2Req *io);
+void HoldClear(struct HoldQueue *hold);
+void HoldExpireAll(struct GenetUnit *unit);
+void GroFlushAll(struct GenetUnit *unit);
+void ReplyRequestList(struct MinList *list);
+void SetupOpenerDelivery(struct Opener *opener);
 void ProcessCommand(struct IOSana2Req *io);
 
 /* Inline function for fast packet type queue lookup */
@@ -237,6 +418,41 @@ static inline struct MinList* GetPacketTypeQueue(struct Opener *opener, UWORD pa
     }
 }
 
+/*
+ * Request ownership. While the driver holds a request on one of its lists,
+ * ln_Name (unused by exec for messages) points at that list, so AbortIO knows
+ * which list and lock it has to deal with. NULL means the request is not on
+ * any list, e.g. it is being processed or sits on the TX ring.
+ */
+#define REQUEST_OWNER(io) (*(struct MinList **)&(io)->ios2_Req.io_Message.mn_Node.ln_Name)
+
+/*
+ * Writes only: timer_get_us() when the write was submitted, for the TX latency
+ * histogram. Kept in the tail of ios2_SrcAddr, past the 6 byte address.
+ */
+#define REQUEST_TIMESTAMP(io) (*(ULONG *)&(io)->ios2_SrcAddr[12])
+
+/* Caller holds the lock protecting the list */
+static inline void QueueRequest(struct MinList *list, struct IOSana2Req *io)
+{
+	REQUEST_OWNER(io) = list;
+	AddTailMinList(list, (struct MinNode *)io);
+}
+
+static inline struct IOSana2Req *DequeueRequest(struct MinList *list)
+{
+	struct IOSana2Req *io = (struct IOSana2Req *)RemHeadMinList(list);
+	if (io)
+		REQUEST_OWNER(io) = NULL;
+	return io;
+}
+
+static inline void UnqueueRequest(struct IOSana2Req *io)
+{
+	RemoveMinNode((struct MinNode *)io);
+	REQUEST_OWNER(io) = NULL;
+}
+
 int Do_S2_ADDMULTICASTADDRESSES(struct IOSana2Req *io);
 int Do_S2_DELMULTICASTADDRESSES(struct IOSana2Req *io);
 void ReportEvents(struct GenetUnit *unit, ULONG eventSet);
@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: MPL-2.0 OR GPL-2.0+
+#ifndef DEVICES_GENET_H
+#define DEVICES_GENET_H
+
+/*
+ * genet.device extensions to SANA-II.
+ *
+ * Private commands are issued on a regular IOSana2Req. Query results are
+ * returned through ios2_StatData. Like Sana2DeviceQuery, every result
+ * structure starts with SizeAvailable (set by the caller to the size of its
+ * buffer) and SizeSupplied (set by the driver to the number of bytes filled).
+ */
+
+#include <exec/types.h>
+
+#define GENET_CMD_BASE 0xC100
+
+#define GENET_CMD_GETPOOLSTATS (GENET_CMD_BASE + 0)
+#define GENET_CMD_SETTRACE (GENET_CMD_BASE + 1) /* ios2_DataLength: GENET_TRACEF_* */
+#define GENET_CMD_GETTRACE (GENET_CMD_BASE + 2)
+#define GENET_CMD_GETLATENCY (GENET_CMD_BASE + 3)
+#define GENET_CMD_CLEARLATENCY (GENET_CMD_BASE + 4)
+#define GENET_CMD_GETWAKEUPS (GENET_CMD_BASE + 5)
+#define GENET_CMD_CLEARWAKEUPS (GENET_CMD_BASE + 6)
+#define GENET_CMD_SETCAPTURE (GENET_CMD_BASE + 7) /* ios2_DataLength: bytes kept per frame, 0 stops capture */
+#define GENET_CMD_GETCAPTURE (GENET_CMD_BASE + 8)
+#define GENET_CMD_SETVLAN (GENET_CMD_BASE + 9) /* ios2_DataLength: 802.1Q VLAN ID of this opener, 0 for untagged */
+#define GENET_CMD_SETFILTER (GENET_CMD_BASE + 10) /* ios2_Data: GenetFilterInsn[ios2_DataLength], 0 removes the filter */
+#define GENET_CMD_TSOWRITE (GENET_CMD_BASE + 11)  /* Like CMD_WRITE, with an IPv4/TCP packet of up to GENET_TSO_MAX bytes */
+#define GENET_CMD_SETGRO (GENET_CMD_BASE + 12)    /* ios2_DataLength: largest merged IPv4 packet this opener takes, 0 turns merging off */
+#define GENET_CMD_SETARP (GENET_CMD_BASE + 13)    /* ios2_Data: IPv4 addresses, ULONG[ios2_DataLength], 0 clears */
+
+/*
+ * GENET_CMD_SETVLAN binds the opener that issues it to one VLAN. Its reads
+ * then only get frames tagged with that ID, with the tag removed, and its
+ * non-raw writes are sent tagged. Raw writes go out as given.
+ */
+#define GENET_VLAN_MAX 4094
+
+/* Allocation sites of the per-unit memory pool */
+#define GENET_POOL_MCAST 0    /* Multicast ranges */
+#define GENET_POOL_RX_CB 1    /* RX ring control blocks */
+#define GENET_POOL_TX_CB 2    /* TX ring control blocks */
+#define GENET_POOL_PHY 3      /* PHY device */
+#define GENET_POOL_LOOPBACK 4 /* Loopback unit frame buffers */
+#define GENET_POOL_CAPTURE 5  /* Packet capture ring */
+#define GENET_POOL_FILTER 6   /* Compiled packet filters */
+#define GENET_POOL_HOLD 7     /* Frames held for openers without a read posted */
+#define GENET_POOL_TSO 8      /* GENET_CMD_TSOWRITE staging buffer */
+#define GENET_POOL_GRO 9      /* GENET_CMD_SETGRO merge buffers */
+#define GENET_POOL_SITES 10
+
+struct GenetPoolSiteStats
+{
+    ULONG CurrentBytes;
+    ULONG PeakBytes;
+    ULONG Allocations;
+    ULONG Frees;
+    ULONG Failures;
+};
+
+/* Filled in by GENET_CMD_GETPOOLSTATS */
+struct GenetPoolStats
+{
+    ULONG SizeAvailable;
+    ULONG SizeSupplied;
+    ULONG CurrentBytes; /* All sites together */
+    ULONG PeakBytes;
+    ULONG Sites; /* Number of valid entries in Site[] */
+    struct GenetPoolSiteStats Site[GENET_POOL_SITES];
+};
+
+/* GENET_CMD_SETTRACE flags */
+#define GENET_TRACEF_ENABLE (1 << 0) /* Record events; tracing stops when clear */
+#define GENET_TRACEF_CLEAR (1 << 1)  /* Discard everything recorded so far */
+
+/* Trace event identifiers and their arguments */
+#define GENET_TRACE_TX_XMIT 1     /* Arg0: length, Arg1: request, Arg2: producer index */
+#define GENET_TRACE_TX_DROP 2     /* Arg0: length, Arg1: request, Arg2: free descriptors */
+#define GENET_TRACE_TX_RECLAIM 3  /* Arg0: packets, Arg1: free descriptors, Arg2: consumer index */
+#define GENET_TRACE_RX_FRAME 4    /* Arg0: length, Arg1: packet type */
+#define GENET_TRACE_RX_DELIVER 5  /* Arg0: length, Arg1: request, Arg2: opener */
+#define GENET_TRACE_RX_NOREQ 6    /* Arg0: packet type, Arg1: opener */
+#define GENET_TRACE_RX_FILTERED 7 /* Arg0: length, Arg1: request (0: GENET_CMD_SETFILTER), Arg2: opener */
+#define GENET_TRACE_RX_COPYFAIL 8 /* Arg0: length, Arg1: request, Arg2: opener */
+#define GENET_TRACE_RX_ORPHAN 9   /* Arg0: packet type, Arg1: length */
+#define GENET_TRACE_RX_MCDROP 10  /* Arg0: length, Arg1: destination address (high 32 bits) */
+#define GENET_TRACE_TX_BACKLOG 11 /* Arg0: length, Arg1: request, Arg2: writes waiting */
+
+struct GenetTraceEvent
+{
+    ULONG Timestamp; /* Microseconds, free running system timer */
+    UBYTE Event;     /* GENET_TRACE_* */
+    UBYTE Unit;
+    UWORD Arg0;
+    ULONG Arg1;
+    ULONG Arg2;
+};
+
+#define GENET_TRACE_MAX 1024 /* Capacity of the trace ring */
+
+/* Filled in by GENET_CMD_GETTRACE: the most recent events that fit, oldest first */
+struct GenetTraceDump
+{
+    ULONG SizeAvailable;
+    ULONG SizeSupplied;
+    ULONG Flags;    /* Current GENET_TRACEF_ENABLE state */
+    ULONG Recorded; /* Events recorded since the last clear, including overwritten ones */
+    ULONG Count;    /* Number of valid entries in Events[] */
+    struct GenetTraceEvent Events[1];
+};
+
+/*
+ * Latency histogram, microseconds. Bucket[0] counts 0 us, Bucket[n] counts
+ * [2^(n-1), 2^n) us; the last bucket is open ended.
+ */
+#define GENET_LATENCY_BUCKETS 20
+
+struct GenetLatencyHistogram
+{
+    ULONG Count;
+    ULONG MaxUs;
+    ULONG Bucket[GENET_LATENCY_BUCKETS];
+};
+
+/* Filled in by GENET_CMD_GETLATENCY */
+struct GenetLatencyStats
+{
+    ULONG SizeAvailable;
+    ULONG SizeSupplied;
+    /* Last RX poll that did not see the frame yet -> read request replied.
+     * An upper bound on the time since DMA completion.
+     */
+    struct GenetLatencyHistogram Rx;
+    /* Descriptor queued by CMD_WRITE -> request replied by TX reclaim */
+    struct GenetLatencyHistogram Tx;
+};
+
+/* Unit task wakeup causes, one wakeup may have several */
+#define GENET_WAKE_COMMAND 0 /* Request queued on the unit port */
+#define GENET_WAKE_OPENER 1  /* Opener added or removed */
+#define GENET_WAKE_POLL 2    /* Poll timer */
+#define GENET_WAKE_STATS 3   /* Statistics timer */
+#define GENET_WAKE_CAUSES 4
+
+/* Unit task phases timed per wakeup */
+#define GENET_PHASE_COMMAND 0
+#define GENET_PHASE_OPENER 1
+#define GENET_PHASE_RX 2
+#define GENET_PHASE_TX 3 /* TX reclaim */
+#define GENET_PHASE_STATS 4
+#define GENET_PHASES 5
+
+/* Count histogram. Bucket[0] counts 0, Bucket[n] counts [2^(n-1), 2^n); the last bucket is open ended. */
+#define GENET_COUNT_BUCKETS 10
+
+struct GenetCountHistogram
+{
+    ULONG Count;
+    ULONG Max;
+    ULONG Bucket[GENET_COUNT_BUCKETS];
+};
+
+/* Filled in by GENET_CMD_GETWAKEUPS. Time counters are microseconds and wrap. */
+struct GenetWakeupStats
+{
+    ULONG SizeAvailable;
+    ULONG SizeSupplied;
+    ULONG Wakeups;
+    ULONG Cause[GENET_WAKE_CAUSES];
+    ULONG IdlePolls;       /* Poll timer wakeups that received and reclaimed nothing */
+    ULONG RxPasses;        /* RX ring checks, one per wakeup while online */
+    ULONG RxEmptyPasses;   /* ... that found no frame */
+    ULONG BurstPolls;      /* Extra polls done by RX_POLL_BURST */
+    ULONG BurstEmptyPolls; /* ... that found no frame */
+    ULONG PhaseUs[GENET_PHASES];
+    struct GenetCountHistogram RxPerWakeup; /* Frames taken from the RX ring */
+    struct GenetCountHistogram TxPerWakeup; /* Packets reclaimed by the poll timer */
+};
+
+#define GENET_CAPTURE_SNAP_MAX 256 /* Largest snap length of GENET_CMD_SETCAPTURE */
+
+/*
+ * Filled in by GENET_CMD_GETCAPTURE: Data[] is a complete pcap file (Ethernet
+ * link type, big endian) with the oldest captured frames that fit. Returned
+ * frames are removed from the driver, call again to get the next ones.
+ * Timestamps come from the free running 1 MHz system timer and wrap.
+ */
+struct GenetCaptureDump
+{
+    ULONG SizeAvailable;
+    ULONG SizeSupplied;
+    ULONG SnapLen;  /* Current snap length, 0 while capture is off */
+    ULONG Captured; /* Frames captured since capture was started */
+    ULONG Dropped;  /* Frames lost because the ring was full */
+    ULONG Count;    /* Frames in Data[] */
+    ULONG Length;   /* Bytes in Data[], pcap header included */
+    UBYTE Data[1];
+};
+
+/*
+ * Packet filter of GENET_CMD_SETFILTER. Runs on every frame before it is
+ * matched against the CMD_READ requests of the opener that set it; a rejected
+ * frame is never copied. Orphan reads are not filtered. Fields are read from
+ * the frame after an 802.1Q tag is removed. A field the frame does not have
+ * (ports of an ARP frame, say) compares false. A promiscuous opener filters
+ * every frame it sees, orphan reads included, as it arrived: a tagged frame
+ * only matches on GENET_FIELD_ETHERTYPE 0x8100.
+ */
+#define GENET_FILTER_MAX 32 /* Instructions per program */
+
+#define GENET_FILTER_JEQ 0    /* (Field & Mask) == Value */
+#define GENET_FILTER_JGE 1    /* (Field & Mask) >= Value */
+#define GENET_FILTER_ACCEPT 2 /* Stop, the frame goes to the opener */
+#define GENET_FILTER_REJECT 3 /* Stop, the opener does not see the frame */
+
+#define GENET_FIELD_ETHERTYPE 0 /* 16 bits */
+#define GENET_FIELD_IP_PROTO 1  /* 8 bits, IPv4 only */
+#define GENET_FIELD_IP_SRC 2    /* 32 bits */
+#define GENET_FIELD_IP_DST 3    /* 32 bits */
+#define GENET_FIELD_SRC_PORT 4  /* 16 bits, TCP and UDP in unfragmented IPv4 */
+#define GENET_FIELD_DST_PORT 5  /* 16 bits */
+#define GENET_FIELDS 6
+
+/* Jumps are forward, the next instruction is the one after this plus JumpTrue or JumpFalse */
+struct GenetFilterInsn
+{
+    UBYTE Op;    /* GENET_FILTER_* */
+    UBYTE Field; /* GENET_FIELD_*, compares only */
+    UBYTE JumpTrue;
+    UBYTE JumpFalse;
+    ULONG Mask; /* 0 compares the whole field */
+    ULONG Value;
+};
+
+/*
+ * GENET_CMD_TSOWRITE takes a non-raw write with ios2_PacketType 0x0800 whose
+ * data is a complete IPv4 packet carrying TCP with payload, larger than the
+ * MTU. ios2_StatData holds the MSS, the TCP payload bytes per segment, as a
+ * ULONG (see GENET_TSO_MSS). It must not be 0, and IP and TCP headers plus the
+ * MSS must fit the 1500 byte MTU, and the packet may need at most 127
+ * segments, or the write fails with S2ERR_BAD_ARGUMENT. Writes wait for each
+ * other in order while one is being sent.
+ * The driver cuts the payload into MSS sized segments, copies the IP and
+ * TCP headers in front of each one, advances the sequence number and IP ID,
+ * clears FIN/PSH on all but the last segment and CWR on all but the first,
+ * and fills in both checksums. The request is replied once the last segment
+ * is sent. Not available on the loopback unit.
+ */
+#define GENET_TSO_MAX 65535
+#define GENET_TSO_MSS(io) (*(ULONG *)&(io)->ios2_StatData)
+
+/*
+ * GENET_CMD_SETGRO lets the opener that issues it receive several TCP segments
+ * in one CMD_READ. In-order segments of the same IPv4 flow (same addresses,
+ * ports, acknowledgment and TCP options, only ACK and PSH set) that arrive in
+ * one pass over the RX ring are appended to the first one, and the read gets
+ * a single packet with lengths and checksums updated. A segment with PSH ends
+ * the merge. Segments with a bad checksum are never merged. The opener's
+ * 0x0800 read buffers must take ios2_DataLength bytes.
+ */
+#define GENET_GRO_MAX 65535
+
+/*
+ * GENET_CMD_SETARP gives the unit the IPv4 addresses the driver answers ARP
+ * requests for by itself, instead of passing them to the stack. The list
+ * replaces the previous one, addresses learned with ARP_OFFLOAD included.
+ * Only untagged requests are answered. Not available on the loopback unit.
+ */
+#define GENET_ARP_MAX 4
+
+#endif /* DEVICES_GENET_H */
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: MPL-2.0 OR GPL-2.0+
+#ifndef _FILTER_H
+#define _FILTER_H
+
+#include <exec/types.h>
+#include <devices/genet.h>
+
+/*
+ * Per-opener packet filter, set with GENET_CMD_SETFILTER. The program is
+ * checked and compiled when it is set: every field becomes a header, an
+ * offset and a width, jumps become absolute, so running it on a frame is a
+ * handful of loads and compares.
+ */
+
+#define FILTER_L2 0 /* Offset from the start of the frame */
+#define FILTER_L3 1 /* ... of the IPv4 header */
+#define FILTER_L4 2 /* ... of the TCP/UDP header */
+
+struct FilterInsn
+{
+    UBYTE op;
+    UBYTE layer;
+    UBYTE offset;
+    UBYTE width; /* 1, 2 or 4 bytes */
+    UBYTE jumpTrue;
+    UBYTE jumpFalse;
+    ULONG mask;
+    ULONG value; /* Already masked */
+};
+
+struct PacketFilter
+{
+    ULONG size; /* Bytes allocated, for UnitFreePooled */
+    UWORD count;
+    struct FilterInsn insn[];
+};
+
+struct GenetUnit;
+struct Opener;
+
+int FilterSet(struct GenetUnit *unit, struct Opener *opener, const struct GenetFilterInsn *program, ULONG count);
+void FilterFree(struct GenetUnit *unit, struct Opener *opener);
+BOOL FilterRun(const struct PacketFilter *filter, const UBYTE *packet, ULONG length);
+
+#endif /* _FILTER_H */
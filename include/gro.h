@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: MPL-2.0 OR GPL-2.0+
+#ifndef _GRO_H
+#define _GRO_H
+
+#include <exec/types.h>
+#include <devices/sana2.h>
+
+/*
+ * Receive segment coalescing, per opener, enabled with GENET_CMD_SETGRO.
+ * In-order TCP segments of one IPv4 flow that arrive within one RX pass are
+ * appended to the first of them, which holds the read taken for it. The pass
+ * ends with GroFlushAll, so nothing is pending while commands run.
+ */
+
+/* A received segment that may be merged, filled in by GroParse */
+struct GroSegment
+{
+    const UBYTE *tcp;
+    UWORD ipLength; /* IPv4 total length, Ethernet padding excluded */
+    UWORD tcpLength;
+    ULONG payload;    /* Bytes after the TCP header */
+    ULONG payloadSum; /* Unfolded checksum of those bytes */
+};
+
+struct GroContext
+{
+    ULONG size;            /* Bytes allocated, for UnitFreePooled */
+    ULONG maxLength;       /* Largest merged IPv4 packet, GENET_CMD_SETGRO */
+    struct IOSana2Req *io; /* Read the merge goes to, NULL while none is pending */
+    ULONG length;          /* Bytes in frame[], Ethernet header included */
+    ULONG nextSeq;         /* Sequence number that continues the merge */
+    ULONG payloadSum;
+    UWORD segments;
+    UBYTE frame[]; /* Offset 26 keeps the IPv4 header longword aligned */
+};
+
+struct GenetUnit;
+struct Opener;
+
+int GroSet(struct GenetUnit *unit, struct Opener *opener, ULONG maxLength);
+void GroFree(struct GenetUnit *unit, struct Opener *opener);
+BOOL GroParse(const struct GroContext *g, const UBYTE *packet, ULONG length, struct GroSegment *seg);
+BOOL GroMerge(struct GroContext *g, const UBYTE *packet, const struct GroSegment *seg);
+void GroStart(struct GroContext *g, struct IOSana2Req *io, const UBYTE *packet, const struct GroSegment *seg);
+void GroFinish(struct GroContext *g);
+
+#endif /* _GRO_H */
@@ -13,9 +13,31 @@
 
 #define DEFAULT_TX_PENDING_FAST_TICKS 0
 #define DEFAULT_TX_RECLAIM_SOFT_US 2000
+#define DEFAULT_TX_REPLY_BATCH 0
+#define DEFAULT_TX_REPLY_BATCH_MAX 0
+#define DEFAULT_TX_REPLY_BATCH_US 0
+#define DEFAULT_TX_BACKLOG 64
 
 #define DEFAULT_RX_POLL_BURST 64
 #define DEFAULT_RX_POLL_BURST_IDLE_BREAK 16
+#define DEFAULT_RX_REPLY_BATCH 0
+#define DEFAULT_RX_HOLD_FRAMES 8
+#define DEFAULT_RX_HOLD_US 2000
+#define RX_HOLD_FRAMES_MAX 64
+#define RX_HOLD_US_MAX 60000000 /* Held frames are also expired by the statistics timer, this keeps their age far from the timer wrap */
+#define DEFAULT_ARP_OFFLOAD 0
+
+/* RX storm control classes, frames per second, 0 is unlimited */
+#define RX_LIMIT_BCAST 0
+#define RX_LIMIT_MCAST 1
+#define RX_LIMIT_UNICAST 2 /* Unicast for other stations, seen while an opener is promiscuous */
+#define RX_LIMIT_CLASSES 3
+#define DEFAULT_RX_LIMIT {0, 0, 0}
+#define DEFAULT_RX_LIMIT_BURST 64
+#define RX_LIMIT_BURST_MAX 4000
+
+#define DEFAULT_TRACE 0
+#define DEFAULT_LOOPBACK_UNIT -1
 
 #define DEFAULT_POLL_LADDER {1000, 1000, 1000, 2000, 2000, 2000, 4000, 8000}
 #define DEFAULT_POLL_LADDER_MAX 32
@@ -28,10 +50,22 @@ struct GenetRuntimeConfig
     UBYTE use_miami_workaround;
     UWORD tx_pending_fast_ticks;
     ULONG tx_reclaim_soft_us;
+    UBYTE tx_reply_batch;
+    UWORD tx_reply_batch_max;
+    ULONG tx_reply_batch_us;
+    UWORD tx_backlog;
     UWORD rx_poll_burst;
     UWORD rx_poll_burst_idle_break;
+    UBYTE rx_reply_batch;
+    UWORD rx_hold_frames;
+    ULONG rx_hold_us;
+    UBYTE arp_offload;
+    ULONG rx_limit[RX_LIMIT_CLASSES];
+    UWORD rx_limit_burst;
     ULONG poll_delay_us[DEFAULT_POLL_LADDER_MAX];
     UWORD poll_delay_len;
+    UBYTE trace;
+    LONG loopback_unit;
 };
 
 extern struct GenetRuntimeConfig genetConfig;
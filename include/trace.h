@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MPL-2.0 OR GPL-2.0+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <exec/types.h>
+#include <devices/genet.h>
+#include <compat.h>
+
+/*
+ * Binary event trace for the hot paths. Recording an event is a handful of
+ * stores into a global ring, cheap enough to stay compiled in; the ring is
+ * read back with GENET_CMD_GETTRACE and decoded by genetctl.
+ * Build with -DGENET_NO_TRACE to remove it completely.
+ */
+
+#define TRACE_ENTRIES GENET_TRACE_MAX /* Must be a power of two */
+
+struct GenetTrace
+{
+    ULONG head; /* Events recorded since the last clear */
+    UBYTE enabled;
+    struct GenetTraceEvent events[TRACE_ENTRIES];
+};
+
+extern struct GenetTrace genetTrace;
+
+void TraceControl(ULONG flags);
+void TraceDump(struct GenetTraceDump *dump, ULONG size);
+
+#ifdef GENET_NO_TRACE
+#define Trace(event, unit, arg0, arg1, arg2) do { } while (0)
+#else
+static inline void Trace(UBYTE event, UBYTE unit, UWORD arg0, ULONG arg1, ULONG arg2)
+{
+    if (likely(!genetTrace.enabled))
+        return;
+
+    /* Writers can be the unit task and callers of BeginIO, so claim the slot atomically */
+    ULONG slot = __atomic_fetch_add(&genetTrace.head, 1, __ATOMIC_RELAXED);
+    struct GenetTraceEvent *e = &genetTrace.events[slot & (TRACE_ENTRIES - 1)];
+    e->Timestamp = timer_get_us();
+    e->Event = event;
+    e->Unit = unit;
+    e->Arg0 = arg0;
+    e->Arg1 = arg1;
+    e->Arg2 = arg2;
+}
+#endif
+
+#endif /* _TRACE_H */
@@ -22,14 +22,28 @@ struct GenetRuntimeConfig genetConfig;
 static void ApplyDefaults()
 {
     static const ULONG def_ladder[] = DEFAULT_POLL_LADDER;
+    static const ULONG def_rx_limit[RX_LIMIT_CLASSES] = DEFAULT_RX_LIMIT;
     genetConfig.unit_task_priority = DEFAULT_UNIT_TASK_PRIORITY;
     genetConfig.unit_stack_bytes = DEFAULT_UNIT_STACK_BYTES;
     genetConfig.use_dma = DEFAULT_USE_DMA;
     genetConfig.use_miami_workaround = DEFAULT_USE_MIAMI_WORKAROUND;
     genetConfig.tx_pending_fast_ticks = DEFAULT_TX_PENDING_FAST_TICKS;
     genetConfig.tx_reclaim_soft_us = DEFAULT_TX_RECLAIM_SOFT_US;
+    genetConfig.tx_reply_batch = DEFAULT_TX_REPLY_BATCH;
+    genetConfig.tx_reply_batch_max = DEFAULT_TX_REPLY_BATCH_MAX;
+    genetConfig.tx_reply_batch_us = DEFAULT_TX_REPLY_BATCH_US;
+    genetConfig.tx_backlog = DEFAULT_TX_BACKLOG;
     genetConfig.rx_poll_burst = DEFAULT_RX_POLL_BURST;
     genetConfig.rx_poll_burst_idle_break = DEFAULT_RX_POLL_BURST_IDLE_BREAK;
+    genetConfig.rx_reply_batch = DEFAULT_RX_REPLY_BATCH;
+    genetConfig.rx_hold_frames = DEFAULT_RX_HOLD_FRAMES;
+    genetConfig.rx_hold_us = DEFAULT_RX_HOLD_US;
+    genetConfig.arp_offload = DEFAULT_ARP_OFFLOAD;
+    for (int i = 0; i < RX_LIMIT_CLASSES; i++)
+        genetConfig.rx_limit[i] = def_rx_limit[i];
+    genetConfig.rx_limit_burst = DEFAULT_RX_LIMIT_BURST;
+    genetConfig.trace = DEFAULT_TRACE;
+    genetConfig.loopback_unit = DEFAULT_LOOPBACK_UNIT;
     genetConfig.poll_delay_len = sizeof(def_ladder) / sizeof(def_ladder[0]);
     for (UWORD i = 0; i < genetConfig.poll_delay_len && i < DEFAULT_POLL_LADDER_MAX; i++)
         genetConfig.poll_delay_us[i] = def_ladder[i];
@@ -150,6 +164,26 @@ void LoadGenetRuntimeConfig()
                     if (StrToLong((STRPTR)val, &v) && v >= 0)
                         genetConfig.tx_reclaim_soft_us = (ULONG)v;
                 }
+                else if (!Stricmp((STRPTR)key, (STRPTR) "TX_REPLY_BATCH"))
+                {
+                    if (StrToLong((STRPTR)val, &v) && v >= 0)
+                        genetConfig.tx_reply_batch = (UBYTE)v;
+                }
+                else if (!Stricmp((STRPTR)key, (STRPTR) "TX_REPLY_BATCH_MAX"))
+                {
+                    if (StrToLong((STRPTR)val, &v) && v >= 0)
+                        genetConfig.tx_reply_batch_max = (UWORD)v;
+                }
+                else if (!Stricmp((STRPTR)key, (STRPTR) "TX_REPLY_BATCH_US"))
+                {
+                    if (StrToLong((STRPTR)val, &v) && v >= 0)
+                        genetConfig.tx_reply_batch_us = (ULONG)v;
+                }
+                else if (!Stricmp((STRPTR)key, (STRPTR) "TX_BACKLOG"))
+                {
+                    if (StrToLong((STRPTR)val, &v) && v >= 0)
+                        genetConfig.tx_backlog = (UWORD)(v > 0xffff ? 0xffff : v);
+                }
                 else if (!Stricmp((STRPTR)key, (STRPTR) "RX_POLL_BURST"))
                 {
                     if (StrToLong((STRPTR)val, &v) && v >= 0)
@@ -160,8 +194,58 @@ void LoadGenetRuntimeConfig()
                     if (StrToLong((STRPTR)val, &v) && v >= 0)
                         genetConfig.rx_poll_burst_idle_break = (UWORD)v;
                 }
+                else if (!Stricmp((STRPTR)key, (STRPTR) "RX_REPLY_BATCH"))
+                {
+                    if (StrToLong((STRPTR)val, &v) && v >= 0)
+                        genetConfig.rx_reply_batch = (UBYTE)v;
+                }
+                else if (!Stricmp((STRPTR)key, (STRPTR) "RX_HOLD_FRAMES"))
+                {
+                    if (StrToLong((STRPTR)val, &v) && v >= 0)
+                        genetConfig.rx_hold_frames = (UWORD)(v > RX_HOLD_FRAMES_MAX ? RX_HOLD_FRAMES_MAX : v);
+                }
+                else if (!Stricmp((STRPTR)key, (STRPTR) "RX_HOLD_US"))
+                {
+                    if (StrToLong((STRPTR)val, &v) && v >= 0)
+                        genetConfig.rx_hold_us = (ULONG)(v > RX_HOLD_US_MAX ? RX_HOLD_US_MAX : v);
+                }
+                else if (!Stricmp((STRPTR)key, (STRPTR) "ARP_OFFLOAD"))
+                {
+                    if (StrToLong((STRPTR)val, &v) && v >= 0)
+                        genetConfig.arp_offload = (UBYTE)v;
+                }
+                else if (!Stricmp((STRPTR)key, (STRPTR) "RX_LIMIT_BCAST"))
+                {
+                    if (StrToLong((STRPTR)val, &v) && v >= 0)
+                        genetConfig.rx_limit[RX_LIMIT_BCAST] = (ULONG)v;
+                }
+                else if (!Stricmp((STRPTR)key, (STRPTR) "RX_LIMIT_MCAST"))
+                {
+                    if (StrToLong((STRPTR)val, &v) && v >= 0)
+                        genetConfig.rx_limit[RX_LIMIT_MCAST] = (ULONG)v;
+                }
+                else if (!Stricmp((STRPTR)key, (STRPTR) "RX_LIMIT_UNICAST"))
+                {
+                    if (StrToLong((STRPTR)val, &v) && v >= 0)
+                        genetConfig.rx_limit[RX_LIMIT_UNICAST] = (ULONG)v;
+                }
+                else if (!Stricmp((STRPTR)key, (STRPTR) "RX_LIMIT_BURST"))
+                {
+                    if (StrToLong((STRPTR)val, &v) && v > 0)
+                        genetConfig.rx_limit_burst = (UWORD)(v > RX_LIMIT_BURST_MAX ? RX_LIMIT_BURST_MAX : v);
+                }
                 else if (!Stricmp((STRPTR)key, (STRPTR) "POLL_DELAY_US"))
                     ParsePollDelayList(val);
+                else if (!Stricmp((STRPTR)key, (STRPTR) "TRACE"))
+                {
+                    if (StrToLong((STRPTR)val, &v) && v >= 0)
+                        genetConfig.trace = (UBYTE)v;
+                }
+                else if (!Stricmp((STRPTR)key, (STRPTR) "LOOPBACK_UNIT"))
+                {
+                    if (StrToLong((STRPTR)val, &v))
+                        genetConfig.loopback_unit = v;
+                }
             }
         }
     }
@@ -178,15 +262,29 @@ void LoadGenetRuntimeConfig()
 void DumpGenetRuntimeConfig()
 {
 #ifdef DEBUG
-    Kprintf("[genet] config: pri=%ld stack_bytes=%lu use_dma=%ld miami=%ld txFastTicks=%ld txSoftUs=%ld rxBurst=%ld/%ld ladder=",
+    Kprintf("[genet] config: pri=%ld stack_bytes=%lu use_dma=%ld miami=%ld txFastTicks=%ld txSoftUs=%ld txBatch=%ld/%ld/%ld txBacklog=%ld rxBurst=%ld/%ld rxBatch=%ld rxHold=%ld/%ld arp=%ld rxLimit=%ld/%ld/%ld/%ld trace=%ld loopback=%ld ladder=",
             genetConfig.unit_task_priority,
             genetConfig.unit_stack_bytes,
             (ULONG)genetConfig.use_dma,
             (ULONG)genetConfig.use_miami_workaround,
             genetConfig.tx_pending_fast_ticks,
             genetConfig.tx_reclaim_soft_us,
+            (ULONG)genetConfig.tx_reply_batch,
+            (ULONG)genetConfig.tx_reply_batch_max,
+            genetConfig.tx_reply_batch_us,
+            (ULONG)genetConfig.tx_backlog,
             genetConfig.rx_poll_burst,
-            genetConfig.rx_poll_burst_idle_break);
+            genetConfig.rx_poll_burst_idle_break,
+            (ULONG)genetConfig.rx_reply_batch,
+            (ULONG)genetConfig.rx_hold_frames,
+            genetConfig.rx_hold_us,
+            (ULONG)genetConfig.arp_offload,
+            genetConfig.rx_limit[RX_LIMIT_BCAST],
+            genetConfig.rx_limit[RX_LIMIT_MCAST],
+            genetConfig.rx_limit[RX_LIMIT_UNICAST],
+            (ULONG)genetConfig.rx_limit_burst,
+            (ULONG)genetConfig.trace,
+            genetConfig.loopback_unit);
     for (UWORD i = 0; i < genetConfig.poll_delay_len; i++)
         Kprintf("%lu%s", genetConfig.poll_delay_us[i], (i + 1 < genetConfig.poll_delay_len) ? "," : "\n");
 #endif
@@ -0,0 +1,643 @@
+// SPDX-License-Identifier: MPL-2.0 OR GPL-2.0+
+/*
+ * genetctl - query and control genet.device private extensions
+ *
+ * Usage: genetctl <command> [args...] [DEVICE=genet.device] [UNIT=0]
+ *
+ * Commands:
+ *   pool       show memory pool usage per allocation site
+ *   trace on|off|clear|dump
+ *              control the binary event trace, dump decodes it
+ *   latency [reset]
+ *              show RX delivery and TX completion latency histograms
+ *   wakeups [reset]
+ *              show why the unit task woke up and how much work it did
+ *   bench [packets] [size]
+ *              send packets and count how often the sender had to wake up
+ *   capture on [snaplen]|off|save <file>
+ *              control packet capture, save writes a pcap file until Ctrl-C
+ *   monitor [seconds]
+ *              open promiscuous and count every frame received
+ */
+#ifdef __INTELLISENSE__
+#include <clib/exec_protos.h>
+#include <clib/dos_protos.h>
+#else
+#include <proto/exec.h>
+#include <proto/dos.h>
+#endif
+
+#include <stddef.h>
+
+#include <exec/types.h>
+#include <exec/memory.h>
+#include <exec/execbase.h>
+#include <utility/tagitem.h>
+#include <dos/dos.h>
+#include <dos/rdargs.h>
+#include <devices/sana2.h>
+#include <devices/genet.h>
+
+static const char version[] __attribute__((used)) = "$VER: genetctl 1.0 (18.10.2026)";
+
+/* dos.library wants CONST_STRPTR, keep the format strings readable */
+#define Print(fmt, ...) Printf((CONST_STRPTR)(fmt), ##__VA_ARGS__)
+
+#define TEMPLATE "COMMAND/A,ARGS/M,DEVICE/K,UNIT/K/N"
+
+enum
+{
+    ARG_COMMAND,
+    ARG_ARGS,
+    ARG_DEVICE,
+    ARG_UNIT,
+    ARG_COUNT
+};
+
+static BOOL MatchName(const char *a, const char *b)
+{
+    while (*a && *b)
+    {
+        char ca = (*a >= 'A' && *a <= 'Z') ? *a + 32 : *a;
+        char cb = (*b >= 'A' && *b <= 'Z') ? *b + 32 : *b;
+        if (ca != cb)
+            return FALSE;
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+static struct MsgPort *port;
+static struct IOSana2Req *io;
+
+static BOOL CopyBuffer(APTR to asm("a0"), APTR from asm("a1"), ULONG len asm("d0"))
+{
+    CopyMem(from, to, len);
+    return TRUE;
+}
+
+/* Only bench and monitor move packets, everything else opens without buffer management */
+static struct TagItem benchTags[] = {
+    {S2_CopyToBuff, (ULONG)CopyBuffer},
+    {S2_CopyFromBuff, (ULONG)CopyBuffer},
+    {TAG_DONE, 0},
+};
+
+static BOOL OpenGenet(CONST_STRPTR device, LONG unit, struct TagItem *tags, ULONG flags)
+{
+    port = CreateMsgPort();
+    if (port == NULL)
+        return FALSE;
+
+    io = (struct IOSana2Req *)CreateIORequest(port, sizeof(struct IOSana2Req));
+    if (io == NULL)
+        return FALSE;
+
+    io->ios2_BufferManagement = tags;
+    if (OpenDevice(device, unit, (struct IORequest *)io, flags) != 0)
+    {
+        Print("Cannot open %s unit %ld\n", (ULONG)device, unit);
+        DeleteIORequest((struct IORequest *)io);
+        io = NULL;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void CloseGenet()
+{
+    if (io)
+    {
+        CloseDevice((struct IORequest *)io);
+        DeleteIORequest((struct IORequest *)io);
+    }
+    if (port)
+        DeleteMsgPort(port);
+}
+
+static BOOL Query(UWORD command, APTR data, ULONG size)
+{
+    ((ULONG *)data)[0] = size; /* SizeAvailable */
+    ((ULONG *)data)[1] = 0;    /* SizeSupplied */
+    io->ios2_Req.io_Command = command;
+    io->ios2_StatData = data;
+    if (DoIO((struct IORequest *)io) != 0)
+    {
+        Print("Command %04lx failed, error %ld/%ld\n", command, io->ios2_Req.io_Error, io->ios2_WireError);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static BOOL Control(UWORD command, ULONG value)
+{
+    io->ios2_Req.io_Command = command;
+    io->ios2_DataLength = value;
+    if (DoIO((struct IORequest *)io) != 0)
+    {
+        Print("Command %04lx failed, error %ld/%ld\n", command, io->ios2_Req.io_Error, io->ios2_WireError);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static LONG CmdPool(STRPTR *args)
+{
+    static const char *const siteNames[GENET_POOL_SITES] = {"multicast", "rx cb", "tx cb", "phy", "loopback", "capture", "filter", "hold", "tso", "gro"};
+    struct GenetPoolStats stats;
+    (void)args;
+
+    if (!Query(GENET_CMD_GETPOOLSTATS, &stats, sizeof(stats)))
+        return RETURN_FAIL;
+
+    Print("Pool in use: %lu bytes, peak %lu bytes\n", stats.CurrentBytes, stats.PeakBytes);
+    Print("%-10s %10s %10s %8s %8s %8s\n", (ULONG) "site", (ULONG) "current", (ULONG) "peak", (ULONG) "allocs", (ULONG) "frees", (ULONG) "failed");
+    for (ULONG i = 0; i < stats.Sites && i < GENET_POOL_SITES; i++)
+    {
+        struct GenetPoolSiteStats *site = &stats.Site[i];
+        Print("%-10s %10lu %10lu %8lu %8lu %8lu\n", (ULONG)siteNames[i], site->CurrentBytes, site->PeakBytes,
+               site->Allocations, site->Frees, site->Failures);
+    }
+    return RETURN_OK;
+}
+
+static const char *const traceFormats[] = {
+    NULL,
+    "tx xmit      len %4lu io %08lx prod %lu\n",
+    "tx drop      len %4lu io %08lx free %lu\n",
+    "tx reclaim   pkts %3lu free %lu cons %lu\n",
+    "rx frame     len %4lu type %04lx\n",
+    "rx deliver   len %4lu io %08lx opener %08lx\n",
+    "rx noreq     type %04lx opener %08lx\n",
+    "rx filtered  len %4lu io %08lx opener %08lx\n",
+    "rx copyfail  len %4lu io %08lx opener %08lx\n",
+    "rx orphan    type %04lx len %lu\n",
+    "rx mcdrop    len %4lu dst %08lx..\n",
+    "tx backlog   len %4lu io %08lx waiting %lu\n",
+};
+
+static LONG TraceDump()
+{
+    const ULONG size = sizeof(struct GenetTraceDump) + (GENET_TRACE_MAX - 1) * sizeof(struct GenetTraceEvent);
+    struct GenetTraceDump *dump = AllocVec(size, MEMF_ANY);
+    if (dump == NULL)
+    {
+        Print("Out of memory\n");
+        return RETURN_FAIL;
+    }
+
+    LONG rc = RETURN_FAIL;
+    if (Query(GENET_CMD_GETTRACE, dump, size))
+    {
+        Print("Trace %s, %lu events recorded, showing %lu\n", (ULONG)((dump->Flags & GENET_TRACEF_ENABLE) ? "on" : "off"),
+              dump->Recorded, dump->Count);
+        ULONG prev = dump->Count ? dump->Events[0].Timestamp : 0;
+        for (ULONG i = 0; i < dump->Count; i++)
+        {
+            struct GenetTraceEvent *e = &dump->Events[i];
+            Print("%10lu %7ld u%ld ", e->Timestamp, (LONG)(e->Timestamp - prev), (ULONG)e->Unit);
+            if (e->Event < sizeof(traceFormats) / sizeof(traceFormats[0]) && traceFormats[e->Event])
+                Print(traceFormats[e->Event], (ULONG)e->Arg0, e->Arg1, e->Arg2);
+            else
+                Print("event %ld %04lx %08lx %08lx\n", (ULONG)e->Event, (ULONG)e->Arg0, e->Arg1, e->Arg2);
+            prev = e->Timestamp;
+        }
+        rc = RETURN_OK;
+    }
+    FreeVec(dump);
+    return rc;
+}
+
+static LONG CmdTrace(STRPTR *args)
+{
+    struct GenetTraceDump state;
+
+    if (args[0] == NULL || MatchName((const char *)args[0], "dump"))
+        return TraceDump();
+
+    if (MatchName((const char *)args[0], "on"))
+        return Control(GENET_CMD_SETTRACE, GENET_TRACEF_ENABLE) ? RETURN_OK : RETURN_FAIL;
+    if (MatchName((const char *)args[0], "off"))
+        return Control(GENET_CMD_SETTRACE, 0) ? RETURN_OK : RETURN_FAIL;
+    if (MatchName((const char *)args[0], "clear"))
+    {
+        /* Keep the current on/off state */
+        if (!Query(GENET_CMD_GETTRACE, &state, offsetof(struct GenetTraceDump, Events)))
+            return RETURN_FAIL;
+        return Control(GENET_CMD_SETTRACE, state.Flags | GENET_TRACEF_CLEAR) ? RETURN_OK : RETURN_FAIL;
+    }
+
+    Print("Usage: trace on|off|clear|dump\n");
+    return RETURN_ERROR;
+}
+
+/* Upper bound of the bucket holding the given percentile */
+static ULONG Percentile(const struct GenetLatencyHistogram *h, ULONG percent)
+{
+    ULONG target = (h->Count * percent + 99) / 100;
+    ULONG seen = 0;
+    for (ULONG i = 0; i < GENET_LATENCY_BUCKETS; i++)
+    {
+        seen += h->Bucket[i];
+        if (seen >= target)
+            return i == GENET_LATENCY_BUCKETS - 1 ? h->MaxUs : (1UL << i);
+    }
+    return h->MaxUs;
+}
+
+static void PrintHistogram(const char *name, const struct GenetLatencyHistogram *h)
+{
+    Print("%s: %lu samples, p50 < %lu us, p99 < %lu us, max %lu us\n", (ULONG)name, h->Count,
+          Percentile(h, 50), Percentile(h, 99), h->MaxUs);
+    for (ULONG i = 0; i < GENET_LATENCY_BUCKETS; i++)
+    {
+        if (h->Bucket[i] == 0)
+            continue;
+        if (i == 0)
+            Print("  %8s %8lu us %10lu\n", (ULONG) "", 0UL, h->Bucket[i]);
+        else if (i == GENET_LATENCY_BUCKETS - 1)
+            Print("  %8lu+%8s    %10lu\n", 1UL << (i - 1), (ULONG) "", h->Bucket[i]);
+        else
+            Print("  %8lu-%8lu us %10lu\n", 1UL << (i - 1), (1UL << i) - 1, h->Bucket[i]);
+    }
+}
+
+static LONG CmdLatency(STRPTR *args)
+{
+    struct GenetLatencyStats stats;
+
+    if (args[0] && MatchName((const char *)args[0], "reset"))
+        return Control(GENET_CMD_CLEARLATENCY, 0) ? RETURN_OK : RETURN_FAIL;
+
+    if (!Query(GENET_CMD_GETLATENCY, &stats, sizeof(stats)))
+        return RETURN_FAIL;
+
+    PrintHistogram("RX poll to reply", &stats.Rx);
+    PrintHistogram("TX write to reply", &stats.Tx);
+    return RETURN_OK;
+}
+
+static void PrintCounts(const char *name, const struct GenetCountHistogram *h)
+{
+    Print("%s: %lu samples, max %lu\n", (ULONG)name, h->Count, h->Max);
+    for (ULONG i = 0; i < GENET_COUNT_BUCKETS; i++)
+    {
+        if (h->Bucket[i] == 0)
+            continue;
+        if (i == 0)
+            Print("  %5s %5lu %10lu\n", (ULONG) "", 0UL, h->Bucket[i]);
+        else if (i == GENET_COUNT_BUCKETS - 1)
+            Print("  %5lu+%5s %10lu\n", 1UL << (i - 1), (ULONG) "", h->Bucket[i]);
+        else
+            Print("  %5lu-%5lu %10lu\n", 1UL << (i - 1), (1UL << i) - 1, h->Bucket[i]);
+    }
+}
+
+static LONG CmdWakeups(STRPTR *args)
+{
+    static const char *const causeNames[GENET_WAKE_CAUSES] = {"command", "opener", "poll", "stats"};
+    static const char *const phaseNames[GENET_PHASES] = {"command", "opener", "rx", "tx reclaim", "stats"};
+    struct GenetWakeupStats stats;
+
+    if (args[0] && MatchName((const char *)args[0], "reset"))
+        return Control(GENET_CMD_CLEARWAKEUPS, 0) ? RETURN_OK : RETURN_FAIL;
+
+    if (!Query(GENET_CMD_GETWAKEUPS, &stats, sizeof(stats)))
+        return RETURN_FAIL;
+
+    Print("Wakeups: %lu\n", stats.Wakeups);
+    for (ULONG i = 0; i < GENET_WAKE_CAUSES; i++)
+        Print("  %-10s %10lu\n", (ULONG)causeNames[i], stats.Cause[i]);
+    Print("Idle polls: %lu of %lu\n", stats.IdlePolls, stats.Cause[GENET_WAKE_POLL]);
+    Print("RX passes: %lu, empty %lu\n", stats.RxPasses, stats.RxEmptyPasses);
+    Print("RX burst polls: %lu, empty %lu\n", stats.BurstPolls, stats.BurstEmptyPolls);
+    Print("Time per phase:\n");
+    for (ULONG i = 0; i < GENET_PHASES; i++)
+        Print("  %-10s %10lu us, %6lu us/wakeup\n", (ULONG)phaseNames[i], stats.PhaseUs[i],
+              stats.Wakeups ? stats.PhaseUs[i] / stats.Wakeups : 0);
+    PrintCounts("RX frames per wakeup", &stats.RxPerWakeup);
+    PrintCounts("TX reclaimed per poll", &stats.TxPerWakeup);
+    return RETURN_OK;
+}
+
+#define CAPTURE_CHUNK 32768
+
+/* Drain the capture ring into a pcap file until Ctrl-C, or until capture is off and nothing is left */
+static LONG CaptureSave(CONST_STRPTR name)
+{
+    struct GenetCaptureDump *dump = AllocVec(CAPTURE_CHUNK, MEMF_ANY);
+    if (dump == NULL)
+    {
+        Print("Out of memory\n");
+        return RETURN_FAIL;
+    }
+
+    BPTR fh = Open(name, MODE_NEWFILE);
+    if (fh == 0)
+    {
+        Print("Cannot open %s\n", (ULONG)name);
+        FreeVec(dump);
+        return RETURN_FAIL;
+    }
+
+    LONG rc = RETURN_FAIL;
+    ULONG frames = 0;
+    BOOL first = TRUE;
+    Print("Saving to %s, Ctrl-C stops\n", (ULONG)name);
+    while (Query(GENET_CMD_GETCAPTURE, dump, CAPTURE_CHUNK))
+    {
+        /* Every chunk is a complete pcap file, keep only the first file header */
+        const ULONG skip = first ? 0 : 24;
+        if (dump->Length > skip && Write(fh, dump->Data + skip, dump->Length - skip) != (LONG)(dump->Length - skip))
+        {
+            Print("Write error\n");
+            break;
+        }
+        first = FALSE;
+        frames += dump->Count;
+
+        if ((SetSignal(0, 0) & SIGBREAKF_CTRL_C) || (dump->SnapLen == 0 && dump->Count == 0))
+        {
+            SetSignal(0, SIGBREAKF_CTRL_C);
+            Print("%lu frames saved, %lu dropped by the driver\n", frames, dump->Dropped);
+            rc = RETURN_OK;
+            break;
+        }
+        if (dump->Count == 0)
+            Delay(5);
+    }
+
+    Close(fh);
+    FreeVec(dump);
+    return rc;
+}
+
+static LONG CmdCapture(STRPTR *args)
+{
+    LONG snapLen = 96;
+
+    if (args[0] && MatchName((const char *)args[0], "on"))
+    {
+        if (args[1] && (StrToLong((CONST_STRPTR)args[1], &snapLen) <= 0 || snapLen <= 0 || snapLen > GENET_CAPTURE_SNAP_MAX))
+            goto usage;
+        return Control(GENET_CMD_SETCAPTURE, snapLen) ? RETURN_OK : RETURN_FAIL;
+    }
+    if (args[0] && MatchName((const char *)args[0], "off"))
+        return Control(GENET_CMD_SETCAPTURE, 0) ? RETURN_OK : RETURN_FAIL;
+    if (args[0] && MatchName((const char *)args[0], "save") && args[1])
+        return CaptureSave((CONST_STRPTR)args[1]);
+
+usage:
+    Print("Usage: capture on [snaplen 1-%ld]|off|save <file>\n", (LONG)GENET_CAPTURE_SNAP_MAX);
+    return RETURN_ERROR;
+}
+
+#define BENCH_INFLIGHT 32
+
+/*
+ * Keep BENCH_INFLIGHT writes queued and count how many times this task had
+ * to wake up to collect the replies. Compare runs with TX_REPLY_BATCH off
+ * and on. Frames go to a locally administered address with the IEEE local
+ * experimental ethertype.
+ */
+static LONG CmdBench(STRPTR *args)
+{
+    static const UBYTE benchDst[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    LONG packets = 10000;
+    LONG size = 1024;
+    struct IOSana2Req *reqs[BENCH_INFLIGHT] = {NULL};
+    LONG rc = RETURN_FAIL;
+
+    if (args[0] && (StrToLong((CONST_STRPTR)args[0], &packets) <= 0 || packets <= 0))
+        goto usage;
+    if (args[0] && args[1] && (StrToLong((CONST_STRPTR)args[1], &size) <= 0 || size < 46 || size > 1500))
+        goto usage;
+
+    UBYTE *payload = AllocVec(size, MEMF_ANY | MEMF_CLEAR);
+    if (payload == NULL)
+    {
+        Print("Out of memory\n");
+        return RETURN_FAIL;
+    }
+
+    for (ULONG i = 0; i < BENCH_INFLIGHT; i++)
+    {
+        reqs[i] = (struct IOSana2Req *)CreateIORequest(port, sizeof(struct IOSana2Req));
+        if (reqs[i] == NULL)
+        {
+            Print("Out of memory\n");
+            goto cleanup;
+        }
+        reqs[i]->ios2_Req.io_Device = io->ios2_Req.io_Device;
+        reqs[i]->ios2_Req.io_Unit = io->ios2_Req.io_Unit;
+        reqs[i]->ios2_BufferManagement = io->ios2_BufferManagement;
+    }
+
+    ULONG sent = 0, done = 0, wakeups = 0, failed = 0;
+    ULONG dispatches = SysBase->DispCount;
+    struct DateStamp start, end;
+    DateStamp(&start);
+
+    for (ULONG i = 0; i < BENCH_INFLIGHT && sent < (ULONG)packets; i++, sent++)
+    {
+        struct IOSana2Req *req = reqs[i];
+        req->ios2_Req.io_Command = CMD_WRITE;
+        req->ios2_Req.io_Flags = 0;
+        req->ios2_PacketType = 0x88b5;
+        CopyMem((APTR)benchDst, req->ios2_DstAddr, sizeof(benchDst));
+        req->ios2_DataLength = size;
+        req->ios2_Data = payload;
+        SendIO((struct IORequest *)req);
+    }
+
+    while (done < sent)
+    {
+        struct IOSana2Req *req;
+        Wait(1UL << port->mp_SigBit);
+        wakeups++;
+        while ((req = (struct IOSana2Req *)GetMsg(port)))
+        {
+            done++;
+            if (req->ios2_Req.io_Error)
+                failed++;
+            if (sent < (ULONG)packets)
+            {
+                req->ios2_DataLength = size;
+                SendIO((struct IORequest *)req);
+                sent++;
+            }
+        }
+    }
+
+    DateStamp(&end);
+    dispatches = SysBase->DispCount - dispatches;
+    ULONG ticks = (end.ds_Days - start.ds_Days) * 24 * 60 * TICKS_PER_SECOND * 60 +
+                  (end.ds_Minute - start.ds_Minute) * 60 * TICKS_PER_SECOND + end.ds_Tick - start.ds_Tick;
+
+    Print("Sent %lu packets of %ld bytes, %lu failed, in %lu ticks\n", done, size, failed, ticks);
+    Print("Sender wakeups: %lu (%lu per 100 packets)\n", wakeups, done ? wakeups * 100 / done : 0);
+    Print("Task dispatches system wide: %lu\n", dispatches);
+    rc = RETURN_OK;
+
+cleanup:
+    for (ULONG i = 0; i < BENCH_INFLIGHT; i++)
+        if (reqs[i])
+            DeleteIORequest((struct IORequest *)reqs[i]);
+    FreeVec(payload);
+    return rc;
+
+usage:
+    Print("Usage: bench [packets] [size 46-1500]\n");
+    return RETURN_ERROR;
+}
+
+static ULONG ElapsedTicks(const struct DateStamp *start)
+{
+    struct DateStamp now;
+    DateStamp(&now);
+    return (now.ds_Days - start->ds_Days) * 24 * 60 * TICKS_PER_SECOND * 60 +
+           (now.ds_Minute - start->ds_Minute) * 60 * TICKS_PER_SECOND + now.ds_Tick - start->ds_Tick;
+}
+
+/*
+ * Keep BENCH_INFLIGHT reads queued on a promiscuous opener and count what
+ * arrives. Together with bench against the loopback unit this measures the
+ * promiscuous delivery path without a wire in between.
+ */
+static LONG CmdMonitor(STRPTR *args)
+{
+    LONG seconds = 10;
+    struct IOSana2Req *reqs[BENCH_INFLIGHT] = {NULL};
+    UBYTE *buffers = NULL;
+    LONG rc = RETURN_FAIL;
+
+    if (args[0] && (StrToLong((CONST_STRPTR)args[0], &seconds) <= 0 || seconds <= 0))
+    {
+        Print("Usage: monitor [seconds]\n");
+        return RETURN_ERROR;
+    }
+
+    buffers = AllocVec(BENCH_INFLIGHT * 1536, MEMF_ANY);
+    if (buffers == NULL)
+    {
+        Print("Out of memory\n");
+        return RETURN_FAIL;
+    }
+
+    for (ULONG i = 0; i < BENCH_INFLIGHT; i++)
+    {
+        reqs[i] = (struct IOSana2Req *)CreateIORequest(port, sizeof(struct IOSana2Req));
+        if (reqs[i] == NULL)
+        {
+            Print("Out of memory\n");
+            goto cleanup;
+        }
+        reqs[i]->ios2_Req.io_Device = io->ios2_Req.io_Device;
+        reqs[i]->ios2_Req.io_Unit = io->ios2_Req.io_Unit;
+        reqs[i]->ios2_BufferManagement = io->ios2_BufferManagement;
+        reqs[i]->ios2_Req.io_Command = CMD_READ;
+        reqs[i]->ios2_Req.io_Flags = SANA2IOF_RAW;
+        reqs[i]->ios2_PacketType = 0; /* Ignored for a promiscuous opener */
+        reqs[i]->ios2_Data = &buffers[i * 1536];
+        SendIO((struct IORequest *)reqs[i]);
+    }
+
+    ULONG frames = 0, bytes = 0, wakeups = 0;
+    struct DateStamp start;
+    DateStamp(&start);
+    Print("Counting frames for %ld seconds, Ctrl-C stops\n", seconds);
+
+    /* Stops at the first wakeup past the deadline, an idle link needs Ctrl-C */
+    while (ElapsedTicks(&start) < (ULONG)seconds * TICKS_PER_SECOND)
+    {
+        struct IOSana2Req *req;
+        if (Wait((1UL << port->mp_SigBit) | SIGBREAKF_CTRL_C) & SIGBREAKF_CTRL_C)
+            break;
+        wakeups++;
+        while ((req = (struct IOSana2Req *)GetMsg(port)))
+        {
+            if (req->ios2_Req.io_Error == 0)
+            {
+                frames++;
+                bytes += req->ios2_DataLength;
+            }
+            SendIO((struct IORequest *)req);
+        }
+    }
+
+    ULONG ticks = ElapsedTicks(&start);
+    if (ticks == 0)
+        ticks = 1;
+    Print("Received %lu frames, %lu bytes in %lu ticks\n", frames, bytes, ticks);
+    Print("%lu frames/s, %lu KB/s, %lu frames per wakeup\n", frames * TICKS_PER_SECOND / ticks,
+          bytes / ticks * TICKS_PER_SECOND / 1024, wakeups ? frames / wakeups : 0);
+    rc = RETURN_OK;
+
+cleanup:
+    for (ULONG i = 0; i < BENCH_INFLIGHT; i++)
+    {
+        if (reqs[i])
+        {
+            if (CheckIO((struct IORequest *)reqs[i]) == NULL)
+                AbortIO((struct IORequest *)reqs[i]);
+            WaitIO((struct IORequest *)reqs[i]);
+            DeleteIORequest((struct IORequest *)reqs[i]);
+        }
+    }
+    FreeVec(buffers);
+    return rc;
+}
+
+static const struct
+{
+    const char *name;
+    LONG (*handler)(STRPTR *args);
+    BOOL sends;      /* Needs buffer management functions */
+    ULONG openFlags; /* SANA2OPF_* */
+} commands[] = {
+    {"pool", CmdPool, FALSE, 0},
+    {"trace", CmdTrace, FALSE, 0},
+    {"latency", CmdLatency, FALSE, 0},
+    {"wakeups", CmdWakeups, FALSE, 0},
+    {"bench", CmdBench, TRUE, 0},
+    {"capture", CmdCapture, FALSE, 0},
+    {"monitor", CmdMonitor, TRUE, SANA2OPF_PROM},
+};
+
+int main(void)
+{
+    LONG args[ARG_COUNT] = {0};
+    LONG rc = RETURN_FAIL;
+
+    struct RDArgs *rda = ReadArgs((CONST_STRPTR)TEMPLATE, args, NULL);
+    if (rda == NULL)
+    {
+        PrintFault(IoErr(), (CONST_STRPTR) "genetctl");
+        return RETURN_FAIL;
+    }
+
+    CONST_STRPTR device = args[ARG_DEVICE] ? (CONST_STRPTR)args[ARG_DEVICE] : (CONST_STRPTR) "genet.device";
+    LONG unit = args[ARG_UNIT] ? *(LONG *)args[ARG_UNIT] : 0;
+    STRPTR *cmdArgs = args[ARG_ARGS] ? (STRPTR *)args[ARG_ARGS] : (STRPTR[]){NULL};
+
+    ULONG i;
+    for (i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+    {
+        if (MatchName((const char *)args[ARG_COMMAND], commands[i].name))
+            break;
+    }
+
+    if (i == sizeof(commands) / sizeof(commands[0]))
+    {
+        Print("Unknown command %s\n", args[ARG_COMMAND]);
+    }
+    else if (OpenGenet(device, unit, commands[i].sends ? benchTags : NULL, commands[i].openFlags))
+    {
+        rc = commands[i].handler(cmdArgs);
+    }
+
+    CloseGenet();
+    FreeArgs(rda);
+    return rc;
+}
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: MPL-2.0 OR GPL-2.0+
+#ifdef __INTELLISENSE__
+#include <clib/exec_protos.h>
+#else
+#include <proto/exec.h>
+#endif
+
+#include <stddef.h>
+
+#include <trace.h>
+
+struct GenetTrace genetTrace;
+
+void TraceControl(ULONG flags)
+{
+    genetTrace.enabled = FALSE;
+    if (flags & GENET_TRACEF_CLEAR)
+        genetTrace.head = 0;
+    genetTrace.enabled = (flags & GENET_TRACEF_ENABLE) ? TRUE : FALSE;
+}
+
+/* Copy out the newest events that fit, oldest first. The ring is not locked,
+ * events recorded while copying may show up torn or not at all.
+ */
+void TraceDump(struct GenetTraceDump *dump, ULONG size)
+{
+    const ULONG header = offsetof(struct GenetTraceDump, Events);
+    ULONG head = genetTrace.head;
+    ULONG count = head < TRACE_ENTRIES ? head : TRACE_ENTRIES;
+    ULONG room = (size - header) / sizeof(struct GenetTraceEvent);
+
+    if (count > room)
+        count = room;
+
+    for (ULONG i = 0; i < count; i++)
+        dump->Events[i] = genetTrace.events[(head - count + i) & (TRACE_ENTRIES - 1)];
+
+    dump->Flags = genetTrace.enabled ? GENET_TRACEF_ENABLE : 0;
+    dump->Recorded = head;
+    dump->Count = count;
+    dump->SizeSupplied = header + count * sizeof(struct GenetTraceEvent);
+}
@@ -20,28 +20,48 @@
 #include <minlist.h>
 #include <runtime_config.h>
 
-static void SetupMDIO(struct GenetUnit *unit)
+static void SetupPins(struct GenetUnit *unit)
 {
-	Kprintf("[genet] %s: Setting up MDIO bus\n", __func__);
-	gpioSetAlternate(unit->gpioBase, PIN_RGMII_MDIO, GPIO_AF_5);
-	gpioSetAlternate(unit->gpioBase, PIN_RGMII_MDC, GPIO_AF_5);
-	gpioSetPull(unit->gpioBase, PIN_RGMII_MDIO, GPIO_PULL_UP);
-	gpioSetPull(unit->gpioBase, PIN_RGMII_MDC, GPIO_PULL_DOWN);
+	Kprintf("[genet] %s: Setting up MDIO and RGMII pins\n", __func__);
+	for (int i = 0; i < unit->pinCount; i++)
+	{
+		gpioSetAlternate(unit->gpioBase, unit->pins[i].pin, unit->pins[i].function);
+		gpioSetPull(unit->gpioBase, unit->pins[i].pin, unit->pins[i].pull);
+	}
 }
 
-static void SetupRGMII(struct GenetUnit *unit)
+APTR UnitAllocPooled(struct GenetUnit *unit, ULONG size, UBYTE site)
 {
-	Kprintf("[genet] %s: Setting up RGMII bus\n", __func__);
-	for (int i = 46; i < 58; i++)
-	{
-		gpioSetAlternate(unit->gpioBase, i, GPIO_AF_INPUT);
-	}
-	gpioSetPull(unit->gpioBase, 46, GPIO_PULL_UP);
-	gpioSetPull(unit->gpioBase, 47, GPIO_PULL_UP);
-	for (int i = 48; i < 58; i++)
+	struct GenetPoolStats *stats = &unit->poolStats;
+	struct GenetPoolSiteStats *siteStats = &stats->Site[site];
+
+	APTR memory = AllocPooled(unit->memoryPool, size);
+	if (memory == NULL)
 	{
-		gpioSetPull(unit->gpioBase, i, GPIO_PULL_DOWN);
+		siteStats->Failures++;
+		return NULL;
 	}
+
+	siteStats->Allocations++;
+	siteStats->CurrentBytes += size;
+	if (siteStats->CurrentBytes > siteStats->PeakBytes)
+		siteStats->PeakBytes = siteStats->CurrentBytes;
+
+	stats->CurrentBytes += size;
+	if (stats->CurrentBytes > stats->PeakBytes)
+		stats->PeakBytes = stats->CurrentBytes;
+
+	return memory;
+}
+
+void UnitFreePooled(struct GenetUnit *unit, APTR memory, ULONG size, UBYTE site)
+{
+	struct GenetPoolSiteStats *siteStats = &unit->poolStats.Site[site];
+
+	FreePooled(unit->memoryPool, memory, size);
+	siteStats->Frees++;
+	siteStats->CurrentBytes -= size;
+	unit->poolStats.CurrentBytes -= size;
 }
 
 int UnitOpen(struct GenetUnit *unit, LONG unitNumber, LONG flags, struct Opener *opener)
@@ -73,26 +93,52 @@ int UnitOpen(struct GenetUnit *unit, LONG unitNumber, LONG flags, struct Opener
 	unit->unit.unit_OpenCnt = 1;
 	unit->unitNumber = unitNumber;
 
+	/* Units without an ethernetN node in the devicetree do not exist, unless it is the loopback unit */
+	int result = S2ERR_NO_ERROR;
+	unit->loopback = unitNumber == genetConfig.loopback_unit;
+	if (unit->loopback)
+		LoopbackInit(unit);
+	else
+		result = DevTreeParse(unit);
+	if (result != S2ERR_NO_ERROR)
+	{
+		Kprintf("[genet] %s: Failed to parse device tree: %ld\n", __func__, result);
+		unit->unit.unit_OpenCnt = 0;
+		return result;
+	}
+
 	unit->memoryPool = CreatePool(MEMF_FAST | MEMF_PUBLIC, 16384, 8192);
 	if (unit->memoryPool == NULL)
 	{
 		Kprintf("[genet] %s: Failed to create memory pool\n", __func__);
+		unit->unit.unit_OpenCnt = 0;
 		return S2ERR_NO_RESOURCES;
 	}
+	_memset(&unit->poolStats, 0, sizeof(unit->poolStats));
+	unit->poolStats.Sites = GENET_POOL_SITES;
+	_memset(&unit->latency, 0, sizeof(unit->latency));
+	unit->capture.slots = NULL;
+	/* Writes are submitted to the TX ring even while offline, the ring lock has to be valid from now on */
+	InitSemaphore(&unit->tx_ring.tx_ring_sem);
+	unit->tx_ring.tx_submit = NULL;
+	unit->tx_ring.tx_draining = FALSE;
+	_NewMinList(&unit->tx_ring.tx_done);
+	_NewMinList(&unit->tx_ring.tx_backlog);
+	_NewMinList(&unit->tx_ring.tso_wait);
+	unit->tx_ring.tx_backlog_count = 0;
+	unit->tx_ring.tso_buffer = NULL;
+	unit->tx_ring.tso_io = NULL;
+	_NewMinList(&unit->rx_ring.rx_done);
+	unit->tx_ring.tx_done_count = 0;
 	_NewMinList(&unit->multicastRanges);
 	unit->multicastCount = 0;
 
 	_NewMinList(&unit->openers);
+	_NewMinList(&unit->promiscOpeners);
+	unit->promiscCount = 0;
 	if (opener != NULL)
 	{
-		AddTailMinList(&unit->openers, (struct MinNode *)opener);
-	}
-
-	int result = DevTreeParse(unit);
-	if (result != S2ERR_NO_ERROR)
-	{
-		Kprintf("[genet] %s: Failed to parse device tree: %ld\n", __func__, result);
-		return result;
+		UnitAddOpener(unit, opener);
 	}
 
 	/* On first open, we initialize current MAC to 0 to indicate it was not set yet */
@@ -103,6 +149,7 @@ int UnitOpen(struct GenetUnit *unit, LONG unitNumber, LONG flags, struct Opener
 		Kprintf("[genet] %s: Failed to start unit task: %ld\n", __func__, result);
 		DeletePool(unit->memoryPool);
 		unit->memoryPool = NULL;
+		unit->unit.unit_OpenCnt = 0;
 		return result;
 	}
 	return S2ERR_NO_ERROR;
@@ -110,8 +157,13 @@ int UnitOpen(struct GenetUnit *unit, LONG unitNumber, LONG flags, struct Opener
 
 int UnitConfigure(struct GenetUnit *unit)
 {
-	SetupMDIO(unit);
-	SetupRGMII(unit);
+	if (unit->loopback)
+	{
+		unit->state = STATE_CONFIGURED;
+		return S2ERR_NO_ERROR;
+	}
+
+	SetupPins(unit);
 
 	Kprintf("[genet] %s: About to probe UMAC\n", __func__);
 	int result = bcmgenet_eth_probe(unit);
@@ -129,11 +181,12 @@ int UnitConfigure(struct GenetUnit *unit)
 int UnitOnline(struct GenetUnit *unit)
 {
 	Kprintf("[genet] %s: About to start UMAC\n", __func__);
-	int result = bcmgenet_gmac_eth_start(unit);
+	int result = unit->loopback ? LoopbackStart(unit) : bcmgenet_gmac_eth_start(unit);
 	if (result != S2ERR_NO_ERROR)
 	{
 		Kprintf("[genet] %s: Failed to start UMAC: %ld\n", __func__, result);
-		bcmgenet_gmac_eth_stop(unit); // This may be needed to free PHY memory
+		if (!unit->loopback)
+			bcmgenet_gmac_eth_stop(unit); // This may be needed to free PHY memory
 		return result;
 	}
 
@@ -145,7 +198,63 @@ void UnitOffline(struct GenetUnit *unit)
 {
 	Kprintf("[genet] %s: Stopping UMAC\n", __func__);
 	unit->state = STATE_OFFLINE;
-	bcmgenet_gmac_eth_stop(unit); // This may be needed to free PHY memory
+	if (unit->loopback)
+		LoopbackStop(unit);
+	else
+		bcmgenet_gmac_eth_stop(unit); // This may be needed to free PHY memory
+}
+
+static void UpdateRxMode(struct GenetUnit *unit)
+{
+	/* Offline, bcmgenet_gmac_eth_start picks up the new mode */
+	if (unit->state == STATE_ONLINE && !unit->loopback)
+		bcmgenet_set_rx_mode(unit);
+}
+
+static ULONG HoldSize(void)
+{
+	return sizeof(struct HoldQueue) + genetConfig.rx_hold_frames * sizeof(struct HoldSlot);
+}
+
+/* Called by the unit task, or by UnitOpen before it runs. The MAC is promiscuous while any opener is. */
+void UnitAddOpener(struct GenetUnit *unit, struct Opener *opener)
+{
+	/* Promiscuous openers are never held for, see DeliverPromiscuous. Without memory the opener just drops. */
+	opener->hold = NULL;
+	if (genetConfig.rx_hold_frames && !opener->promiscuous)
+	{
+		opener->hold = UnitAllocPooled(unit, HoldSize(), GENET_POOL_HOLD);
+		if (opener->hold)
+		{
+			opener->hold->size = genetConfig.rx_hold_frames;
+			HoldClear(opener->hold);
+		}
+	}
+
+	if (opener->promiscuous)
+	{
+		AddTailMinList(&unit->promiscOpeners, (struct MinNode *)opener);
+		if (unit->promiscCount++ == 0)
+			UpdateRxMode(unit);
+	}
+	else
+	{
+		AddTailMinList(&unit->openers, (struct MinNode *)opener);
+	}
+}
+
+void UnitRemoveOpener(struct GenetUnit *unit, struct Opener *opener)
+{
+	RemoveMinNode((struct MinNode *)opener);
+	FilterFree(unit, opener);
+	GroFree(unit, opener);
+	if (opener->hold)
+	{
+		UnitFreePooled(unit, opener->hold, HoldSize(), GENET_POOL_HOLD);
+		opener->hold = NULL;
+	}
+	if (opener->promiscuous && --unit->promiscCount == 0)
+		UpdateRxMode(unit);
 }
 
 int UnitClose(struct GenetUnit *unit, struct Opener *opener)
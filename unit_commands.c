@@ -11,9 +11,12 @@
 #include <devices/sana2specialstats.h>
 #include <devices/newstyle.h>
 
+#include <stddef.h>
+
 #include <device.h>
 #include <debug.h>
 #include <compat.h>
+#include <trace.h>
 
 static const UWORD GENET_SupportedCommands[] = {
     CMD_FLUSH,
@@ -40,6 +43,21 @@ static const UWORD GENET_SupportedCommands[] = {
     S2_DELMULTICASTADDRESSES,
 
     NSCMD_DEVICEQUERY,
+
+    GENET_CMD_GETPOOLSTATS,
+    GENET_CMD_SETTRACE,
+    GENET_CMD_GETTRACE,
+    GENET_CMD_GETLATENCY,
+    GENET_CMD_CLEARLATENCY,
+    GENET_CMD_GETWAKEUPS,
+    GENET_CMD_CLEARWAKEUPS,
+    GENET_CMD_SETCAPTURE,
+    GENET_CMD_GETCAPTURE,
+    GENET_CMD_SETVLAN,
+    GENET_CMD_SETFILTER,
+    GENET_CMD_TSOWRITE,
+    GENET_CMD_SETGRO,
+    GENET_CMD_SETARP,
     0};
 
 /* Mask of events known by the driver */
@@ -47,6 +65,28 @@ static const UWORD GENET_SupportedCommands[] = {
                     S2EVENT_TX | S2EVENT_RX | S2EVENT_BUFF | \
                     S2EVENT_ERROR | S2EVENT_HARDWARE | S2EVENT_SOFTWARE)
 
+static void ReportOpenerEvents(struct Opener *opener, ULONG eventSet)
+{
+    struct MinNode *ioNode, *nextIoNode;
+    ObtainSemaphore(&opener->openerSemaphore);
+    for (ioNode = opener->eventQueue.mlh_Head; (nextIoNode = ioNode->mln_Succ) != NULL; ioNode = nextIoNode)
+    {
+        struct IOSana2Req *io = (struct IOSana2Req *)ioNode;
+        /* Check if event mask in WireError fits the events occured */
+        if (io->ios2_WireError & eventSet)
+        {
+            /* We have a match. Leave only matching events in wire error */
+            io->ios2_WireError &= eventSet;
+
+            /* Reply it */
+            UnqueueRequest(io);
+            ReplyMsg((struct Message *)io);
+            break; /* Only one event per opener */
+        }
+    }
+    ReleaseSemaphore(&opener->openerSemaphore);
+}
+
 /* Report events to this unit */
 void ReportEvents(struct GenetUnit *unit, ULONG eventSet)
 {
@@ -54,27 +94,9 @@ void ReportEvents(struct GenetUnit *unit, ULONG eventSet)
 
     /* Report event to every listener of every opener accepting the mask */
     for (struct MinNode *node = unit->openers.mlh_Head; node->mln_Succ; node = node->mln_Succ)
-    {
-        struct Opener *opener = (struct Opener *)node;
-        struct MinNode *ioNode, *nextIoNode;
-        ObtainSemaphore(&opener->openerSemaphore);
-        for (ioNode = opener->eventQueue.mlh_Head; (nextIoNode = ioNode->mln_Succ) != NULL; ioNode = nextIoNode)
-        {
-            struct IOSana2Req *io = (struct IOSana2Req *)ioNode;
-            /* Check if event mask in WireError fits the events occured */
-            if (io->ios2_WireError & eventSet)
-            {
-                /* We have a match. Leave only matching events in wire error */
-                io->ios2_WireError &= eventSet;
-
-                /* Reply it */
-                Remove((struct Node *)io);
-                ReplyMsg((struct Message *)io);
-                break; /* Only one event per opener */
-            }
-        }
-        ReleaseSemaphore(&opener->openerSemaphore);
-    }
+        ReportOpenerEvents((struct Opener *)node, eventSet);
+    for (struct MinNode *node = unit->promiscOpeners.mlh_Head; node->mln_Succ; node = node->mln_Succ)
+        ReportOpenerEvents((struct Opener *)node, eventSet);
     KprintfH("[genet] %s: Reporting done\n", __func__);
 }
 
@@ -108,12 +130,56 @@ static int Do_S2_ONEVENT(struct IOSana2Req *io)
         struct Opener *opener = io->ios2_BufferManagement;
         // io->ios2_Req.io_Flags &= ~IOF_QUICK;
         ObtainSemaphore(&opener->openerSemaphore);
-        AddTailMinList(&opener->eventQueue, (struct MinNode *)io);
+        QueueRequest(&opener->eventQueue, io);
         ReleaseSemaphore(&opener->openerSemaphore);
         return COMMAND_SCHEDULED;
     }
 }
 
+static void FlushOpener(struct Opener *opener)
+{
+    struct IOSana2Req *req;
+
+    ObtainSemaphore(&opener->openerSemaphore);
+    while ((req = DequeueRequest(&opener->orphanQueue)))
+    {
+        req->ios2_Req.io_Error = IOERR_ABORTED;
+        req->ios2_WireError = 0;
+        ReplyMsg((struct Message *)req);
+    }
+
+    while ((req = DequeueRequest(&opener->eventQueue)))
+    {
+        req->ios2_Req.io_Error = IOERR_ABORTED;
+        req->ios2_WireError = 0;
+        ReplyMsg((struct Message *)req);
+    }
+
+    while ((req = DequeueRequest(&opener->readQueue)))
+    {
+        req->ios2_Req.io_Error = IOERR_ABORTED;
+        req->ios2_WireError = 0;
+        ReplyMsg((struct Message *)req);
+    }
+
+    while ((req = DequeueRequest(&opener->ipv4Queue)))
+    {
+        req->ios2_Req.io_Error = IOERR_ABORTED;
+        req->ios2_WireError = 0;
+        ReplyMsg((struct Message *)req);
+    }
+
+    while ((req = DequeueRequest(&opener->arpQueue)))
+    {
+        req->ios2_Req.io_Error = IOERR_ABORTED;
+        req->ios2_WireError = 0;
+        ReplyMsg((struct Message *)req);
+    }
+
+    HoldClear(opener->hold);
+    ReleaseSemaphore(&opener->openerSemaphore);
+}
+
 static int Do_CMD_FLUSH(struct IOSana2Req *io)
 {
     struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
@@ -123,6 +189,7 @@ static int Do_CMD_FLUSH(struct IOSana2Req *io)
     /* Flush and cancel all requests */
     while ((req = (struct IOSana2Req *)GetMsg(&unit->unit.unit_MsgPort)))
     {
+        REQUEST_OWNER(req) = NULL;
         req->ios2_Req.io_Error = IOERR_ABORTED;
         req->ios2_WireError = 0;
         ReplyMsg((struct Message *)req);
@@ -130,45 +197,9 @@ static int Do_CMD_FLUSH(struct IOSana2Req *io)
 
     /* For every opener, flush all internal queues */
     for (struct MinNode *node = unit->openers.mlh_Head; node->mln_Succ; node = node->mln_Succ)
-    {
-        struct Opener *opener = (struct Opener *)node;
-        ObtainSemaphore(&opener->openerSemaphore);
-        while ((req = (struct IOSana2Req *)RemHeadMinList(&opener->orphanQueue)))
-        {
-            req->ios2_Req.io_Error = IOERR_ABORTED;
-            req->ios2_WireError = 0;
-            ReplyMsg((struct Message *)req);
-        }
-
-        while ((req = (struct IOSana2Req *)RemHeadMinList(&opener->eventQueue)))
-        {
-            req->ios2_Req.io_Error = IOERR_ABORTED;
-            req->ios2_WireError = 0;
-            ReplyMsg((struct Message *)req);
-        }
-
-        while ((req = (struct IOSana2Req *)RemHeadMinList(&opener->readQueue)))
-        {
-            req->ios2_Req.io_Error = IOERR_ABORTED;
-            req->ios2_WireError = 0;
-            ReplyMsg((struct Message *)req);
-        }
-
-        while ((req = (struct IOSana2Req *)RemHeadMinList(&opener->ipv4Queue)))
-        {
-            req->ios2_Req.io_Error = IOERR_ABORTED;
-            req->ios2_WireError = 0;
-            ReplyMsg((struct Message *)req);
-        }
-
-        while ((req = (struct IOSana2Req *)RemHeadMinList(&opener->arpQueue)))
-        {
-            req->ios2_Req.io_Error = IOERR_ABORTED;
-            req->ios2_WireError = 0;
-            ReplyMsg((struct Message *)req);
-        }
-        ReleaseSemaphore(&opener->openerSemaphore);
-    }
+        FlushOpener((struct Opener *)node);
+    for (struct MinNode *node = unit->promiscOpeners.mlh_Head; node->mln_Succ; node = node->mln_Succ)
+        FlushOpener((struct Opener *)node);
     KprintfH("[genet] %s: Flush completed\n", __func__);
 
     return COMMAND_PROCESSED;
@@ -211,13 +242,22 @@ static inline int Do_CMD_READ(struct IOSana2Req *io)
     struct Opener *opener = io->ios2_BufferManagement;
     UWORD packetType = io->ios2_PacketType;
 
-    /* Get the appropriate queue for this packet type */
-    struct MinList *queue = GetPacketTypeQueue(opener, packetType);
+    /* Get the appropriate queue for this packet type, promiscuous openers take any type */
+    struct MinList *queue = unlikely(opener->promiscuous) ? &opener->readQueue : GetPacketTypeQueue(opener, packetType);
+
+    ObtainSemaphore(&opener->openerSemaphore);
+    /* A frame that came in while no read was posted is older than anything still to come */
+    if (unlikely(opener->hold && opener->hold->count) && ReadHeldFrame(io))
+    {
+        ReleaseSemaphore(&opener->openerSemaphore);
+        if (unlikely(io->ios2_Req.io_Error))
+            ReportEvents(unit, S2EVENT_BUFF | S2EVENT_RX | S2EVENT_SOFTWARE | S2EVENT_ERROR);
+        return COMMAND_PROCESSED;
+    }
 
     /* Queue the request */
     io->ios2_Req.io_Flags &= ~IOF_QUICK;
-    ObtainSemaphore(&opener->openerSemaphore);
-    AddTailMinList(queue, (struct MinNode *)io);
+    QueueRequest(queue, io);
     ReleaseSemaphore(&opener->openerSemaphore);
 
     KprintfH("[genet] %s: Queued CMD_READ request for packet type 0x%lx\n", __func__, packetType);
@@ -239,7 +279,9 @@ static inline int Do_S2_READORPHAN(struct IOSana2Req *io)
 
     struct Opener *opener = io->ios2_BufferManagement;
     // io->ios2_Req.io_Flags &= ~IOF_QUICK;
-    AddTailMinList(&opener->orphanQueue, (struct MinNode *)io);
+    ObtainSemaphore(&opener->openerSemaphore);
+    QueueRequest(&opener->orphanQueue, io);
+    ReleaseSemaphore(&opener->openerSemaphore);
     return COMMAND_SCHEDULED;
 }
 
@@ -257,6 +299,16 @@ static inline int Do_CMD_WRITE(struct IOSana2Req *io)
     }
 
     io->ios2_Req.io_Flags &= ~IOF_QUICK;
+    if (unlikely(unit->loopback))
+    {
+        if (io->ios2_Req.io_Command == GENET_CMD_TSOWRITE)
+        {
+            io->ios2_Req.io_Error = S2ERR_NOT_SUPPORTED;
+            io->ios2_WireError = S2WERR_GENERIC_ERROR;
+            return COMMAND_PROCESSED;
+        }
+        return LoopbackXmit(io, unit);
+    }
     int result = bcmgenet_xmit(io, unit);
     return result;
 }
@@ -282,6 +334,194 @@ int Do_S2_DEVICEQUERY(struct IOSana2Req *io)
     return COMMAND_PROCESSED;
 }
 
+/* Copy a driver statistics block to ios2_StatData, honouring SizeAvailable */
+static int ReturnStatistics(struct IOSana2Req *io, CONST_APTR stats, ULONG size)
+{
+    ULONG *dst = io->ios2_StatData;
+    const ULONG header = 2 * sizeof(ULONG); /* SizeAvailable, SizeSupplied */
+
+    if (dst == NULL || dst[0] < header)
+    {
+        io->ios2_Req.io_Error = S2ERR_BAD_ARGUMENT;
+        io->ios2_WireError = S2WERR_NULL_POINTER;
+        return COMMAND_PROCESSED;
+    }
+
+    ULONG supplied = dst[0] < size ? dst[0] : size;
+    CopyMem((UBYTE *)stats + header, (UBYTE *)dst + header, supplied - header);
+    dst[1] = supplied;
+    return COMMAND_PROCESSED;
+}
+
+static int Do_GENET_CMD_GETPOOLSTATS(struct IOSana2Req *io)
+{
+    struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+    KprintfH("[genet] %s: GENET_CMD_GETPOOLSTATS\n", __func__);
+
+    return ReturnStatistics(io, &unit->poolStats, sizeof(unit->poolStats));
+}
+
+static int Do_GENET_CMD_SETTRACE(struct IOSana2Req *io)
+{
+    KprintfH("[genet] %s: GENET_CMD_SETTRACE flags 0x%lx\n", __func__, io->ios2_DataLength);
+
+    TraceControl(io->ios2_DataLength);
+    return COMMAND_PROCESSED;
+}
+
+static int Do_GENET_CMD_GETTRACE(struct IOSana2Req *io)
+{
+    struct GenetTraceDump *dump = io->ios2_StatData;
+    KprintfH("[genet] %s: GENET_CMD_GETTRACE\n", __func__);
+
+    if (dump == NULL || dump->SizeAvailable < offsetof(struct GenetTraceDump, Events))
+    {
+        io->ios2_Req.io_Error = S2ERR_BAD_ARGUMENT;
+        io->ios2_WireError = S2WERR_NULL_POINTER;
+        return COMMAND_PROCESSED;
+    }
+
+    TraceDump(dump, dump->SizeAvailable);
+    return COMMAND_PROCESSED;
+}
+
+static int Do_GENET_CMD_GETLATENCY(struct IOSana2Req *io)
+{
+    struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+    KprintfH("[genet] %s: GENET_CMD_GETLATENCY\n", __func__);
+
+    return ReturnStatistics(io, &unit->latency, sizeof(unit->latency));
+}
+
+static int Do_GENET_CMD_CLEARLATENCY(struct IOSana2Req *io)
+{
+    struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+    KprintfH("[genet] %s: GENET_CMD_CLEARLATENCY\n", __func__);
+
+    _memset(&unit->latency, 0, sizeof(unit->latency));
+    return COMMAND_PROCESSED;
+}
+
+static int Do_GENET_CMD_GETWAKEUPS(struct IOSana2Req *io)
+{
+    struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+    KprintfH("[genet] %s: GENET_CMD_GETWAKEUPS\n", __func__);
+
+    return ReturnStatistics(io, &unit->wakeups, sizeof(unit->wakeups));
+}
+
+static int Do_GENET_CMD_CLEARWAKEUPS(struct IOSana2Req *io)
+{
+    struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+    KprintfH("[genet] %s: GENET_CMD_CLEARWAKEUPS\n", __func__);
+
+    _memset(&unit->wakeups, 0, sizeof(unit->wakeups));
+    return COMMAND_PROCESSED;
+}
+
+static int Do_GENET_CMD_SETCAPTURE(struct IOSana2Req *io)
+{
+    struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+    KprintfH("[genet] %s: GENET_CMD_SETCAPTURE snap %ld\n", __func__, io->ios2_DataLength);
+
+    if (io->ios2_DataLength == 0)
+    {
+        CaptureStop(unit);
+    }
+    else if (CaptureStart(unit, io->ios2_DataLength) != S2ERR_NO_ERROR)
+    {
+        io->ios2_Req.io_Error = S2ERR_NO_RESOURCES;
+        io->ios2_WireError = S2WERR_BUFF_ERROR;
+    }
+    return COMMAND_PROCESSED;
+}
+
+static int Do_GENET_CMD_GETCAPTURE(struct IOSana2Req *io)
+{
+    struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+    struct GenetCaptureDump *dump = io->ios2_StatData;
+    KprintfH("[genet] %s: GENET_CMD_GETCAPTURE\n", __func__);
+
+    /* Room for at least the pcap file header */
+    if (dump == NULL || dump->SizeAvailable < offsetof(struct GenetCaptureDump, Data) + 24)
+    {
+        io->ios2_Req.io_Error = S2ERR_BAD_ARGUMENT;
+        io->ios2_WireError = S2WERR_NULL_POINTER;
+        return COMMAND_PROCESSED;
+    }
+
+    CaptureDump(&unit->capture, dump, dump->SizeAvailable);
+    return COMMAND_PROCESSED;
+}
+
+static int Do_GENET_CMD_SETVLAN(struct IOSana2Req *io)
+{
+    struct Opener *opener = io->ios2_BufferManagement;
+    KprintfH("[genet] %s: GENET_CMD_SETVLAN %ld\n", __func__, io->ios2_DataLength);
+
+    if (opener == NULL || io->ios2_DataLength > GENET_VLAN_MAX)
+    {
+        io->ios2_Req.io_Error = S2ERR_BAD_ARGUMENT;
+        io->ios2_WireError = S2WERR_GENERIC_ERROR;
+        return COMMAND_PROCESSED;
+    }
+
+    /* A single word store, the unit task picks it up with the next frame */
+    opener->vlanId = io->ios2_DataLength;
+    return COMMAND_PROCESSED;
+}
+
+static int Do_GENET_CMD_SETFILTER(struct IOSana2Req *io)
+{
+    struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+    struct Opener *opener = io->ios2_BufferManagement;
+    KprintfH("[genet] %s: GENET_CMD_SETFILTER %ld instructions\n", __func__, io->ios2_DataLength);
+
+    int error = opener ? FilterSet(unit, opener, io->ios2_Data, io->ios2_DataLength) : S2ERR_BAD_ARGUMENT;
+    if (error != S2ERR_NO_ERROR)
+    {
+        io->ios2_Req.io_Error = error;
+        io->ios2_WireError = error == S2ERR_NO_RESOURCES ? S2WERR_BUFF_ERROR : S2WERR_GENERIC_ERROR;
+    }
+    return COMMAND_PROCESSED;
+}
+
+static int Do_GENET_CMD_SETGRO(struct IOSana2Req *io)
+{
+    struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+    struct Opener *opener = io->ios2_BufferManagement;
+    KprintfH("[genet] %s: GENET_CMD_SETGRO %ld\n", __func__, io->ios2_DataLength);
+
+    int error = opener ? GroSet(unit, opener, io->ios2_DataLength) : S2ERR_BAD_ARGUMENT;
+    if (error != S2ERR_NO_ERROR)
+    {
+        io->ios2_Req.io_Error = error;
+        io->ios2_WireError = error == S2ERR_NO_RESOURCES ? S2WERR_BUFF_ERROR : S2WERR_GENERIC_ERROR;
+    }
+    return COMMAND_PROCESSED;
+}
+
+static int Do_GENET_CMD_SETARP(struct IOSana2Req *io)
+{
+    struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+    KprintfH("[genet] %s: GENET_CMD_SETARP %ld addresses\n", __func__, io->ios2_DataLength);
+
+    if (unit->loopback)
+    {
+        io->ios2_Req.io_Error = S2ERR_NOT_SUPPORTED;
+        io->ios2_WireError = S2WERR_GENERIC_ERROR;
+        return COMMAND_PROCESSED;
+    }
+
+    int error = ArpSet(unit, io->ios2_Data, io->ios2_DataLength);
+    if (error != S2ERR_NO_ERROR)
+    {
+        io->ios2_Req.io_Error = error;
+        io->ios2_WireError = S2WERR_GENERIC_ERROR;
+    }
+    return COMMAND_PROCESSED;
+}
+
 static int Do_S2_ONLINE(struct IOSana2Req *io)
 {
     struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
@@ -392,6 +632,7 @@ void ProcessCommand(struct IOSana2Req *io)
             *(UWORD *)&io->ios2_DstAddr[4] = 0xFFFF;
 #pragma GCC diagnostic pop
         case S2_MULTICAST: /* Fallthrough */
+        case GENET_CMD_TSOWRITE: /* Fallthrough */
         case CMD_WRITE:
             complete = Do_CMD_WRITE(io);
             break;
@@ -457,6 +698,46 @@ void ProcessCommand(struct IOSana2Req *io)
             complete = Do_S2_ONEVENT(io);
             break;
 
+        case GENET_CMD_GETPOOLSTATS:
+            complete = Do_GENET_CMD_GETPOOLSTATS(io);
+            break;
+        case GENET_CMD_SETTRACE:
+            complete = Do_GENET_CMD_SETTRACE(io);
+            break;
+        case GENET_CMD_GETTRACE:
+            complete = Do_GENET_CMD_GETTRACE(io);
+            break;
+        case GENET_CMD_GETLATENCY:
+            complete = Do_GENET_CMD_GETLATENCY(io);
+            break;
+        case GENET_CMD_CLEARLATENCY:
+            complete = Do_GENET_CMD_CLEARLATENCY(io);
+            break;
+        case GENET_CMD_GETWAKEUPS:
+            complete = Do_GENET_CMD_GETWAKEUPS(io);
+            break;
+        case GENET_CMD_CLEARWAKEUPS:
+            complete = Do_GENET_CMD_CLEARWAKEUPS(io);
+            break;
+        case GENET_CMD_SETCAPTURE:
+            complete = Do_GENET_CMD_SETCAPTURE(io);
+            break;
+        case GENET_CMD_GETCAPTURE:
+            complete = Do_GENET_CMD_GETCAPTURE(io);
+            break;
+        case GENET_CMD_SETVLAN:
+            complete = Do_GENET_CMD_SETVLAN(io);
+            break;
+        case GENET_CMD_SETFILTER:
+            complete = Do_GENET_CMD_SETFILTER(io);
+            break;
+        case GENET_CMD_SETGRO:
+            complete = Do_GENET_CMD_SETGRO(io);
+            break;
+        case GENET_CMD_SETARP:
+            complete = Do_GENET_CMD_SETARP(io);
+            break;
+
         default:
             io->ios2_Req.io_Error = IOERR_NOCMD;
             complete = COMMAND_PROCESSED;
@@ -69,7 +69,7 @@ int Do_S2_ADDMULTICASTADDRESSES(struct IOSana2Req *io)
     }
 
     /* No range was found. Create new one and add the multicast range on the WiFi module */
-    struct MulticastRange *range = AllocPooled(unit->memoryPool, sizeof(struct MulticastRange));
+    struct MulticastRange *range = UnitAllocPooled(unit, sizeof(struct MulticastRange), GENET_POOL_MCAST);
     if (!range)
     {
         Kprintf("[genet] %s: Failed to allocate memory for multicast range\n", __func__);
@@ -87,7 +87,8 @@ int Do_S2_ADDMULTICASTADDRESSES(struct IOSana2Req *io)
     unit->multicastCount += count;
 
     /* Update PROMISC and MDF filter */
-    bcmgenet_set_rx_mode(unit);
+    if (!unit->loopback)
+        bcmgenet_set_rx_mode(unit);
     return COMMAND_PROCESSED;
 }
 
@@ -128,13 +129,14 @@ int Do_S2_DELMULTICASTADDRESSES(struct IOSana2Req *io)
             if (range->useCount == 0)
             {
                 RemoveMinNode((struct MinNode *)range);
-                FreePooled(unit->memoryPool, range, sizeof(struct MulticastRange));
+                UnitFreePooled(unit, range, sizeof(struct MulticastRange), GENET_POOL_MCAST);
 
                 ULONG count = upper_bound - lower_bound + 1;
                 unit->multicastCount -= count;
 
                 /* Update PROMISC and MDF filter */
-                bcmgenet_set_rx_mode(unit);
+                if (!unit->loopback)
+                    bcmgenet_set_rx_mode(unit);
             }
             return COMMAND_PROCESSED;
         }
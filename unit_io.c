@@ -11,11 +11,28 @@
 #include <compat.h>
 #include <debug.h>
 #include <runtime_config.h>
+#include <trace.h>
 
-static inline void CopyPacket(struct IOSana2Req *io, UBYTE *packet, ULONG packetLength)
+/* Reply a chain of requests with task switching held off, so each receiver wakes once for all of them */
+void ReplyRequestList(struct MinList *list)
+{
+    struct IOSana2Req *io;
+
+    Forbid();
+    while ((io = (struct IOSana2Req *)RemHeadMinList(list)))
+        ReplyMsg((struct Message *)io);
+    Permit();
+}
+
+/*
+ * Fills a read request from a frame. FALSE if the opener's filter hook rejected it.
+ * A failed copy only sets io_Error, callers report it with no opener semaphore held.
+ * Only ever expanded with constant raw, filter and miami, see FILL_VARIANT.
+ */
+static inline __attribute__((always_inline)) BOOL FillRequestAs(struct IOSana2Req *io, UBYTE *packet, ULONG packetLength,
+                                                                const BOOL raw, const BOOL filter, const BOOL miami)
 {
     struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
-    KprintfH("[genet] %s: Copying packet of length %ld\n", __func__, packetLength);
     struct Opener *opener = io->ios2_BufferManagement;
 
 #pragma GCC diagnostic push
@@ -27,13 +44,6 @@ static inline void CopyPacket(struct IOSana2Req *io, UBYTE *packet, ULONG packet
     *(UWORD *)&io->ios2_SrcAddr[4] = *(UWORD *)&packet[10];
 #pragma GCC diagnostic pop
     io->ios2_PacketType = *(UWORD *)&packet[12];
-    KprintfH("[genet] %s: Source address: %02lx:%02lx:%02lx:%02lx:%02lx:%02lx\n", __func__,
-             io->ios2_SrcAddr[0], io->ios2_SrcAddr[1], io->ios2_SrcAddr[2],
-             io->ios2_SrcAddr[3], io->ios2_SrcAddr[4], io->ios2_SrcAddr[5]);
-    KprintfH("[genet] %s: Destination address: %02lx:%02lx:%02lx:%02lx:%02lx:%02lx\n", __func__,
-             io->ios2_DstAddr[0], io->ios2_DstAddr[1], io->ios2_DstAddr[2],
-             io->ios2_DstAddr[3], io->ios2_DstAddr[4], io->ios2_DstAddr[5]);
-    KprintfH("[genet] %s: Packet type: 0x%lx\n", __func__, io->ios2_PacketType);
 
     /* Clear broadcast and multicast flags */
     io->ios2_Req.io_Flags &= ~(SANA2IOF_BCAST | SANA2IOF_MCAST);
@@ -41,13 +51,11 @@ static inline void CopyPacket(struct IOSana2Req *io, UBYTE *packet, ULONG packet
     /* If dest address is FF:FF:FF:FF:FF:FF then it is a broadcast */
     if (*(ULONG *)packet == 0xffffffff && *(UWORD *)(packet + 4) == 0xffff)
     {
-        KprintfH("[genet] %s: Packet is a broadcast\n", __func__);
         io->ios2_Req.io_Flags |= SANA2IOF_BCAST;
     }
     /* If dest address has lowest bit of first addr byte set, then it is a multicast */
     else if (*packet & 0x01)
     {
-        KprintfH("[genet] %s: Packet is a multicast\n", __func__);
         io->ios2_Req.io_Flags |= SANA2IOF_MCAST;
     }
 
@@ -57,41 +65,192 @@ static inline void CopyPacket(struct IOSana2Req *io, UBYTE *packet, ULONG packet
         Unfortunately, forcing RAW packet on Roadshow does not work, so we have to copy
         if the flag is not set.
     */
-    if (!(io->ios2_Req.io_Flags & SANA2IOF_RAW))
+    if (!raw)
     {
-        KprintfH("[genet] %s: Copying only data part of the packet\n", __func__);
         /* Copy only data part of the packet */
         packet += ETH_HLEN;
         packetLength -= ETH_HLEN;
     }
 
     /* Filter packet if CMD_READ and filter hook is set */
-    UBYTE packetFiltered = FALSE;
-    if (opener->packetFilter && io->ios2_Req.io_Command == CMD_READ && !CallHookPkt(opener->packetFilter, io, packet))
+    if (filter && io->ios2_Req.io_Command == CMD_READ && !CallHookPkt(opener->packetFilter, io, packet))
     {
-        KprintfH("[genet] %s: Packet filtered by hook\n", __func__);
-        packetFiltered = TRUE;
+        Trace(GENET_TRACE_RX_FILTERED, unit->unitNumber, packetLength, (ULONG)io, (ULONG)opener);
+        return FALSE;
+    }
+
+    ULONG copyLen = miami ? ((packetLength + 3) & ~3u) : packetLength;
+    if (unlikely(packetLength == 0) || opener->CopyToBuff(io->ios2_Data, packet, copyLen) == 0)
+    {
+        Trace(GENET_TRACE_RX_COPYFAIL, unit->unitNumber, packetLength, (ULONG)io, (ULONG)opener);
+        unit->internalStats.rx_dropped++;
+        io->ios2_WireError = S2WERR_BUFF_ERROR;
+        io->ios2_Req.io_Error = S2ERR_NO_RESOURCES;
     }
 
+    /* Set number of bytes received */
+    io->ios2_DataLength = packetLength;
+
+    Trace(GENET_TRACE_RX_DELIVER, unit->unitNumber, packetLength, (ULONG)io, (ULONG)opener);
+    return TRUE;
+}
+
+#define FILL_VARIANT(name, raw, filter, miami)                                  \
+    static BOOL name(struct IOSana2Req *io, UBYTE *packet, ULONG packetLength) \
+    {                                                                          \
+        return FillRequestAs(io, packet, packetLength, raw, filter, miami);    \
+    }
+
+FILL_VARIANT(FillCooked, FALSE, FALSE, FALSE)
+FILL_VARIANT(FillRaw, TRUE, FALSE, FALSE)
+FILL_VARIANT(FillCookedHook, FALSE, TRUE, FALSE)
+FILL_VARIANT(FillRawHook, TRUE, TRUE, FALSE)
+FILL_VARIANT(FillCookedMiami, FALSE, FALSE, TRUE)
+FILL_VARIANT(FillRawMiami, TRUE, FALSE, TRUE)
+FILL_VARIANT(FillCookedHookMiami, FALSE, TRUE, TRUE)
+FILL_VARIANT(FillRawHookMiami, TRUE, TRUE, TRUE)
+
+/* [miami][filter][raw] */
+static BOOL (*const fillVariants[2][2][2])(struct IOSana2Req *, UBYTE *, ULONG) = {
+    {{FillCooked, FillRaw}, {FillCookedHook, FillRawHook}},
+    {{FillCookedMiami, FillRawMiami}, {FillCookedHookMiami, FillRawHookMiami}},
+};
+
+/* Stands in for a copy hook the stack did not give, every copy then fails like a refused one */
+static BOOL NoCopyBuff(APTR to asm("a0") __attribute__((unused)), APTR from asm("a1") __attribute__((unused)),
+                       ULONG len asm("d0") __attribute__((unused)))
+{
+    return FALSE;
+}
+
+/* Called by createOpener once the tags are in, nothing on the packet paths checks them again */
+void SetupOpenerDelivery(struct Opener *opener)
+{
+    const BOOL miami = genetConfig.use_miami_workaround != 0;
+    const BOOL filter = opener->packetFilter != NULL;
+
+    if (opener->CopyToBuff == NULL)
+        opener->CopyToBuff = NoCopyBuff;
+    if (opener->CopyFromBuff == NULL)
+        opener->CopyFromBuff = NoCopyBuff;
+    opener->fill[0] = fillVariants[miami][filter][0];
+    opener->fill[1] = fillVariants[miami][filter][1];
+    opener->txPad = miami ? 3 : 0;
+}
+
+static inline BOOL FillRequest(struct IOSana2Req *io, UBYTE *packet, ULONG packetLength)
+{
+    struct Opener *opener = io->ios2_BufferManagement;
+    return opener->fill[(io->ios2_Req.io_Flags & SANA2IOF_RAW) != 0](io, packet, packetLength);
+}
+
+static inline void CopyPacket(struct IOSana2Req *io, UBYTE *packet, ULONG packetLength)
+{
+    struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+
     /* Packet not filtered. Send it now and reply request. */
-    if (likely(!packetFiltered))
+    if (likely(FillRequest(io, packet, packetLength)))
     {
-        ULONG copyLen = genetConfig.use_miami_workaround ? ((packetLength + 3) & ~3u) : packetLength;
-        if (unlikely(packetLength == 0 || !opener->CopyToBuff) || opener->CopyToBuff(io->ios2_Data, packet, copyLen) == 0)
-        {
-            KprintfH("[genet] %s: Failed to copy packet data to buffer\n", __func__);
-            unit->internalStats.rx_dropped++;
-            io->ios2_WireError = S2WERR_BUFF_ERROR;
-            io->ios2_Req.io_Error = S2ERR_NO_RESOURCES;
+        if (unlikely(io->ios2_Req.io_Error))
             ReportEvents(unit, S2EVENT_BUFF | S2EVENT_RX | S2EVENT_SOFTWARE | S2EVENT_ERROR);
-        }
+        LatencyRecord(&unit->latency.Rx, timer_get_us() - unit->rx_ring.rx_frame_time);
+        if (likely(genetConfig.rx_reply_batch))
+            AddTailMinList(&unit->rx_ring.rx_done, (struct MinNode *)io);
+        else
+            ReplyMsg((struct Message *)io);
+    }
+}
 
-        /* Set number of bytes received */
-        io->ios2_DataLength = packetLength;
+/* The hold functions below are called with the opener semaphore held */
 
-        ReplyMsg((struct Message *)io);
-        KprintfH("[genet] %s: Packet copied and request replied\n", __func__);
+/* Forgets taken and expired frames at the old end */
+static void HoldExpire(struct GenetUnit *unit, struct HoldQueue *hold)
+{
+    ULONG now = timer_get_us();
+
+    while (hold->count)
+    {
+        struct HoldSlot *slot = &hold->slots[hold->head];
+        if (slot->length && now - slot->timestamp <= genetConfig.rx_hold_us)
+            break;
+        /* Callers hold different opener semaphores, CMD_READ runs in the stack's task */
+        if (slot->length)
+            __atomic_add_fetch(&unit->internalStats.rx_hold_expired, 1, __ATOMIC_RELAXED);
+        if (++hold->head == hold->size)
+            hold->head = 0;
+        hold->count--;
+    }
+}
+
+static void HoldFrame(struct GenetUnit *unit, struct HoldQueue *hold, UBYTE *packet, ULONG packetLength)
+{
+    HoldExpire(unit, hold);
+    if (hold->count == hold->size || packetLength > HOLD_SLOT_SIZE)
+    {
+        unit->internalStats.rx_arp_ip_dropped++;
+        return;
+    }
+
+    UWORD index = hold->head + hold->count;
+    if (index >= hold->size)
+        index -= hold->size;
+    struct HoldSlot *slot = &hold->slots[index];
+    slot->timestamp = timer_get_us();
+    slot->length = packetLength;
+    slot->packetType = *(UWORD *)&packet[12];
+    CopyMem(packet, slot->data, packetLength);
+    hold->count++;
+    unit->internalStats.rx_held++;
+}
+
+/* Unit task, from the statistics timer. Frames nobody asked for go even when no traffic comes to expire them. */
+void HoldExpireAll(struct GenetUnit *unit)
+{
+    for (struct MinNode *node = unit->openers.mlh_Head; node->mln_Succ; node = node->mln_Succ)
+    {
+        struct Opener *opener = (struct Opener *)node;
+        if (opener->hold == NULL)
+            continue;
+        ObtainSemaphore(&opener->openerSemaphore);
+        HoldExpire(unit, opener->hold);
+        ReleaseSemaphore(&opener->openerSemaphore);
+    }
+}
+
+void HoldClear(struct HoldQueue *hold)
+{
+    if (hold)
+    {
+        hold->head = 0;
+        hold->count = 0;
+    }
+}
+
+/* CMD_READ, any task. Serves the request from the oldest held frame of its type, TRUE if it did.
+ * A failed copy is left in io_Error, the caller reports it once the opener semaphore is released.
+ */
+BOOL ReadHeldFrame(struct IOSana2Req *io)
+{
+    struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+    struct HoldQueue *hold = ((struct Opener *)io->ios2_BufferManagement)->hold;
+    BOOL done = FALSE;
+
+    HoldExpire(unit, hold);
+    UWORD index = hold->head;
+    for (UWORD i = 0; i < hold->count && !done; i++)
+    {
+        struct HoldSlot *slot = &hold->slots[index];
+        if (slot->length && slot->packetType == io->ios2_PacketType)
+        {
+            /* Taken either way, a frame the filter hook rejected is not offered again */
+            done = FillRequest(io, slot->data, slot->length);
+            slot->length = 0;
+        }
+        if (++index == hold->size)
+            index = 0;
     }
+    HoldExpire(unit, hold);
+    return done;
 }
 
 static inline BOOL MulticastFilter(struct GenetUnit *unit, uint64_t destAddr)
@@ -114,25 +273,213 @@ static inline BOOL MulticastFilter(struct GenetUnit *unit, uint64_t destAddr)
     return TRUE; /* Broadcast or unicast */
 }
 
+/* Moves the MAC addresses over the 802.1Q tag, the payload stays where it is */
+static inline UBYTE *StripVlanTag(UBYTE *packet)
+{
+    *(ULONG *)&packet[12] = *(ULONG *)&packet[8];
+    *(ULONG *)&packet[8] = *(ULONG *)&packet[4];
+    *(ULONG *)&packet[4] = *(ULONG *)&packet[0];
+    return packet + VLAN_HLEN;
+}
+
+static inline BOOL IsForeignUnicast(struct GenetUnit *unit, const UBYTE *packet)
+{
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wstrict-aliasing"
+    return !(packet[0] & 0x01) &&
+           (*(ULONG *)&packet[0] != *(ULONG *)&unit->currentMacAddress[0] ||
+            *(UWORD *)&packet[4] != *(UWORD *)&unit->currentMacAddress[4]);
+#pragma GCC diagnostic pop
+}
+
+/* Storm control. FALSE if the frame's class is over its rate, the frame is dropped before any opener sees it. */
+static BOOL RxLimitPass(struct GenetUnit *unit, const UBYTE *packet)
+{
+    const ULONG cost = 1000000;
+    UBYTE class;
+
+    if (*(ULONG *)packet == 0xffffffff && *(UWORD *)(packet + 4) == 0xffff)
+        class = RX_LIMIT_BCAST;
+    else if (packet[0] & 0x01)
+        class = RX_LIMIT_MCAST;
+    else if (IsForeignUnicast(unit, packet))
+        class = RX_LIMIT_UNICAST;
+    else
+        return TRUE;
+
+    ULONG rate = genetConfig.rx_limit[class];
+    if (rate == 0)
+        return TRUE;
+
+    struct RxLimiter *l = &unit->rxLimit[class];
+    ULONG now = timer_get_us();
+    ULONG full = genetConfig.rx_limit_burst * cost;
+    uint64_t tokens = l->tokens + (uint64_t)(now - l->last) * rate;
+    l->last = now;
+    if (tokens > full)
+        tokens = full;
+    if (tokens < cost)
+    {
+        l->tokens = tokens;
+        unit->internalStats.rx_limited[class]++;
+        return FALSE;
+    }
+    l->tokens = tokens - cost;
+    return TRUE;
+}
+
+/* Promiscuous openers take any frame on their oldest read, no type matching, multicast nobody subscribed to included */
+static BOOL DeliverPromiscuous(struct GenetUnit *unit, UBYTE *packet, ULONG packetLength)
+{
+    BOOL activity = FALSE;
+
+    for (struct MinNode *node = unit->promiscOpeners.mlh_Head; node->mln_Succ; node = node->mln_Succ)
+    {
+        struct Opener *opener = (struct Opener *)node;
+        if (opener->filter && !FilterRun(opener->filter, packet, packetLength))
+        {
+            Trace(GENET_TRACE_RX_FILTERED, unit->unitNumber, packetLength, 0, (ULONG)opener);
+            continue;
+        }
+        ObtainSemaphore(&opener->openerSemaphore);
+        struct IOSana2Req *io = DequeueRequest(&opener->readQueue);
+        if (io == NULL)
+            io = DequeueRequest(&opener->orphanQueue);
+        ReleaseSemaphore(&opener->openerSemaphore);
+
+        if (likely(io != NULL))
+        {
+            CopyPacket(io, packet, packetLength);
+            activity = TRUE;
+        }
+        else
+        {
+            Trace(GENET_TRACE_RX_NOREQ, unit->unitNumber, *(UWORD *)&packet[12], (ULONG)opener, 0);
+        }
+    }
+    return activity;
+}
+
+static void GroFlush(struct GroContext *g)
+{
+    struct IOSana2Req *io = g->io;
+    struct GenetUnit *unit = (struct GenetUnit *)io->ios2_Req.io_Unit;
+
+    GroFinish(g);
+    g->io = NULL;
+    unit->internalStats.rx_gro_flushes++;
+    CopyPacket(io, g->frame, g->length);
+}
+
+/* Unit task, at the end of each RX pass */
+void GroFlushAll(struct GenetUnit *unit)
+{
+    if (likely(unit->groCount == 0))
+        return;
+
+    for (struct MinNode *node = unit->openers.mlh_Head; node->mln_Succ; node = node->mln_Succ)
+    {
+        struct Opener *opener = (struct Opener *)node;
+        if (opener->gro && opener->gro->io)
+            GroFlush(opener->gro);
+    }
+}
+
+/*
+ * IPv4 frame for an opener with GENET_CMD_SETGRO on. TRUE if it went into a
+ * merge, FALSE if it takes the normal path, after any merge it cannot join.
+ */
+static BOOL GroReceive(struct GenetUnit *unit, struct Opener *opener, UBYTE *packet, ULONG packetLength)
+{
+    struct GroContext *g = opener->gro;
+    struct GroSegment seg;
+
+    if (!GroParse(g, packet, packetLength, &seg))
+    {
+        if (g->io)
+            GroFlush(g);
+        return FALSE;
+    }
+    if (g->io)
+    {
+        if (GroMerge(g, packet, &seg))
+        {
+            unit->internalStats.rx_gro_merged++;
+            return TRUE;
+        }
+        GroFlush(g);
+    }
+
+    ObtainSemaphore(&opener->openerSemaphore);
+    struct IOSana2Req *io = DequeueRequest(&opener->ipv4Queue);
+    ReleaseSemaphore(&opener->openerSemaphore);
+    if (io == NULL)
+        return FALSE;
+
+    GroStart(g, io, packet, &seg);
+    return TRUE;
+}
+
 BOOL ReceiveFrame(struct GenetUnit *unit, UBYTE *packet, ULONG packetLength)
 {
-    /* We only need to filter in software if MDF is not enabled */
+    BOOL activity = FALSE;
+
+    CaptureFrame(&unit->capture, NULL, 0, packet, packetLength);
+
+    /* We only need to filter in software if MDF is not enabled. Promiscuous openers still get what is filtered. */
+    BOOL subscribed = TRUE;
     if (unlikely(!unit->mdfEnabled))
     {
         uint64_t destAddr = ((uint64_t)*(UWORD *)&packet[0] << 32) | *(ULONG *)&packet[2];
         if (!MulticastFilter(unit, destAddr))
         {
-            return FALSE; // Not a multicast address we accept, drop the packet
+            Trace(GENET_TRACE_RX_MCDROP, unit->unitNumber, packetLength, (ULONG)(destAddr >> 16), 0);
+            subscribed = FALSE;
+            if (likely(!unit->promiscCount))
+                return activity; // Not a multicast address we accept, drop the packet
         }
     }
 
+    /* Storm control only counts frames somebody takes. Frames for us alone are never limited. */
+    if (unlikely((packet[0] & 0x01) || unit->promiscCount) && !RxLimitPass(unit, packet))
+        return activity;
+
+    if (unlikely(unit->promiscCount))
+    {
+        activity = DeliverPromiscuous(unit, packet, packetLength);
+
+        /* Unicast to someone else only got here because the MAC is promiscuous, the other openers never see it */
+        if (IsForeignUnicast(unit, packet))
+        {
+            unit->stats.PacketsReceived++;
+            unit->internalStats.rx_packets++;
+            unit->internalStats.rx_bytes += packetLength;
+            return activity;
+        }
+        if (!subscribed)
+            return activity;
+    }
+
     unit->stats.PacketsReceived++;
     unit->internalStats.rx_packets++;
     unit->internalStats.rx_bytes += packetLength;
     UWORD packetType = *(UWORD *)&packet[12];
     UBYTE orphan = TRUE;
-    BOOL activity = FALSE;
-    KprintfH("[genet] %s: Received packet of length %ld with type 0x%lx\n", __func__, packetLength, packetType);
+    Trace(GENET_TRACE_RX_FRAME, unit->unitNumber, packetLength, packetType, 0);
+
+    /* Tagged frames go to the openers bound to their VLAN, through the same queues as untagged ones */
+    UWORD vlanId = 0;
+    if (unlikely(packetType == ETH_P_8021Q) && packetLength >= ETH_HLEN + VLAN_HLEN)
+    {
+        vlanId = *(UWORD *)&packet[14] & VLAN_VID_MASK;
+        packet = StripVlanTag(packet);
+        packetLength -= VLAN_HLEN;
+        packetType = *(UWORD *)&packet[12];
+    }
+
+    /* Requests for our own addresses are answered right here and never wake the stack */
+    if (unlikely(packetType == 0x0806) && unit->arp.count && vlanId == 0 && ArpAnswer(unit, packet, packetLength))
+        return activity;
 
     /* Fast path for common packet types */
     if (likely(packetType == 0x0800 || packetType == 0x0806))
@@ -140,9 +487,29 @@ BOOL ReceiveFrame(struct GenetUnit *unit, UBYTE *packet, ULONG packetLength)
         for (struct MinNode *node = unit->openers.mlh_Head; node->mln_Succ; node = node->mln_Succ)
         {
             struct Opener *opener = (struct Opener *)node;
+            if (opener->vlanId != vlanId)
+                continue;
+            if (opener->filter && !FilterRun(opener->filter, packet, packetLength))
+            {
+                Trace(GENET_TRACE_RX_FILTERED, unit->unitNumber, packetLength, 0, (ULONG)opener);
+                orphan = FALSE;
+                continue;
+            }
+            if (opener->gro && packetType == 0x0800 && GroReceive(unit, opener, packet, packetLength))
+            {
+                orphan = FALSE;
+                activity = TRUE;
+                continue;
+            }
             struct MinList *queue = GetPacketTypeQueue(opener, packetType);
             ObtainSemaphore(&opener->openerSemaphore);
-            struct IOSana2Req *io = (struct IOSana2Req *)RemHeadMinList(queue);
+            struct IOSana2Req *io = DequeueRequest(queue);
+            /* No read posted right now, keep the frame for the next one */
+            if (unlikely(io == NULL) && opener->hold)
+            {
+                HoldFrame(unit, opener->hold, packet, packetLength);
+                orphan = FALSE;
+            }
             ReleaseSemaphore(&opener->openerSemaphore);
 
             if (likely(io != NULL))
@@ -154,7 +521,9 @@ BOOL ReceiveFrame(struct GenetUnit *unit, UBYTE *packet, ULONG packetLength)
             }
             else
             {
-                unit->internalStats.rx_arp_ip_dropped++;
+                Trace(GENET_TRACE_RX_NOREQ, unit->unitNumber, packetType, (ULONG)opener, 0);
+                if (opener->hold == NULL)
+                    unit->internalStats.rx_arp_ip_dropped++;
             }
         }
     }
@@ -164,6 +533,14 @@ BOOL ReceiveFrame(struct GenetUnit *unit, UBYTE *packet, ULONG packetLength)
         for (struct MinNode *node = unit->openers.mlh_Head; node->mln_Succ; node = node->mln_Succ)
         {
             struct Opener *opener = (struct Opener *)node;
+            if (opener->vlanId != vlanId)
+                continue;
+            if (opener->filter && !FilterRun(opener->filter, packet, packetLength))
+            {
+                Trace(GENET_TRACE_RX_FILTERED, unit->unitNumber, packetLength, 0, (ULONG)opener);
+                orphan = FALSE;
+                continue;
+            }
             ObtainSemaphore(&opener->openerSemaphore);
             /* Go through all IO read requests pending*/
             for (struct MinNode *ioNode = opener->readQueue.mlh_Head; ioNode->mln_Succ; ioNode = ioNode->mln_Succ)
@@ -173,8 +550,7 @@ BOOL ReceiveFrame(struct GenetUnit *unit, UBYTE *packet, ULONG packetLength)
                 // 802.3 has no packet type but just length
                 if (io->ios2_PacketType == packetType || (packetType <= 1500 && io->ios2_PacketType <= 1500))
                 {
-                    KprintfH("[genet] %s: Found opener for packet type 0x%lx\n", __func__, packetType);
-                    Remove((struct Node *)io);
+                    UnqueueRequest(io);
                     /* Match, copy packet, break loop for this opener */
                     CopyPacket(io, packet, packetLength);
 
@@ -193,16 +569,20 @@ BOOL ReceiveFrame(struct GenetUnit *unit, UBYTE *packet, ULONG packetLength)
     {
         unit->stats.UnknownTypesReceived++;
         unit->internalStats.rx_dropped++;
+        Trace(GENET_TRACE_RX_ORPHAN, unit->unitNumber, packetType, packetLength, 0);
 
         /* Go through all openers and offer orphan packet to anyone asking */
         for (struct MinNode *node = unit->openers.mlh_Head; node->mln_Succ; node = node->mln_Succ)
         {
             struct Opener *opener = (struct Opener *)node;
+            if (opener->vlanId != vlanId)
+                continue;
             /* Check if orphan port has any pending requests */
-            struct IOSana2Req *io = (struct IOSana2Req *)RemHeadMinList(&opener->orphanQueue);
+            ObtainSemaphore(&opener->openerSemaphore);
+            struct IOSana2Req *io = DequeueRequest(&opener->orphanQueue);
+            ReleaseSemaphore(&opener->openerSemaphore);
             if (unlikely(io != NULL))
             {
-                KprintfH("[genet] %s: Found opener for orphan packet type 0x%lx\n", __func__, packetType);
                 CopyPacket(io, packet, packetLength);
                 activity = TRUE;
             }
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: MPL-2.0 OR GPL-2.0+
+#ifdef __INTELLISENSE__
+#include <clib/exec_protos.h>
+#else
+#include <proto/exec.h>
+#endif
+
+#include <bcmgenet-regs.h>
+#include <device.h>
+#include <compat.h>
+#include <debug.h>
+#include <trace.h>
+
+/*
+ * Software loopback unit, selected with LOOPBACK_UNIT in ENV:genet.prefs.
+ * Writes go through the regular beginIO/submit/ProcessCommand path, but
+ * instead of the TX ring the frame is copied into an in-memory ring which the
+ * unit task drains like the RX ring, handing each frame to ReceiveFrame. Each
+ * write signals the unit task, so frames do not wait for the poll timer.
+ * Nothing touches MMIO, so the cost of the stack facing half of the driver
+ * can be measured on its own.
+ */
+
+#define RX_FRAME_OFFSET 2 /* Same alignment as RX_BUF_OFFSET, keeps the IP header longword aligned */
+
+static const UBYTE loopbackMacAddress[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+void LoopbackInit(struct GenetUnit *unit)
+{
+    Kprintf("[genet] %s: Unit %ld is a software loopback\n", __func__, unit->unitNumber);
+    unit->compatible = (CONST_STRPTR) "loopback";
+    unit->localMacAddress = loopbackMacAddress;
+    unit->lb_ring.buffer = NULL;
+}
+
+int LoopbackStart(struct GenetUnit *unit)
+{
+    struct loopback_ring *ring = &unit->lb_ring;
+
+    ring->buffer = UnitAllocPooled(unit, LOOPBACK_SLOTS * LOOPBACK_SLOT_SIZE, GENET_POOL_LOOPBACK);
+    if (ring->buffer == NULL)
+    {
+        Kprintf("[genet] %s: Failed to allocate loopback ring\n", __func__);
+        return S2ERR_NO_RESOURCES;
+    }
+    ring->prod_index = 0;
+    ring->cons_index = 0;
+
+    /* No descriptors in use, so nobody tries to reclaim the TX ring */
+    unit->tx_ring.free_bds = TX_DESCS;
+    return S2ERR_NO_ERROR;
+}
+
+void LoopbackStop(struct GenetUnit *unit)
+{
+    struct loopback_ring *ring = &unit->lb_ring;
+
+    /* The unit is offline already, a writer holding the ring lock finishes first */
+    ObtainSemaphore(&unit->tx_ring.tx_ring_sem);
+    if (ring->buffer)
+    {
+        UnitFreePooled(unit, ring->buffer, LOOPBACK_SLOTS * LOOPBACK_SLOT_SIZE, GENET_POOL_LOOPBACK);
+        ring->buffer = NULL;
+    }
+    bcmgenet_tx_ring_release(unit);
+}
+
+/* CMD_WRITE and friends, called with the unit online. The request is complete when this returns. */
+int LoopbackXmit(struct IOSana2Req *io, struct GenetUnit *unit)
+{
+    struct loopback_ring *ring = &unit->lb_ring;
+    struct Opener *opener = io->ios2_BufferManagement;
+    const BOOL raw = (io->ios2_Req.io_Flags & SANA2IOF_RAW) != 0;
+    const ULONG header = raw ? 0 : (opener->vlanId ? ETH_HLEN + VLAN_HLEN : ETH_HLEN);
+
+    ObtainSemaphore(&unit->tx_ring.tx_ring_sem);
+
+    UWORD prod = ring->prod_index;
+    UWORD cons = __atomic_load_n(&ring->cons_index, __ATOMIC_ACQUIRE);
+    if (unlikely(ring->buffer == NULL || (UWORD)(prod - cons) >= LOOPBACK_SLOTS))
+        goto ret_error;
+
+    if (unlikely(io->ios2_DataLength == 0 || header + io->ios2_DataLength > LOOPBACK_SLOT_SIZE - RX_FRAME_OFFSET))
+        goto ret_error;
+
+    UBYTE *frame = &ring->buffer[(prod & (LOOPBACK_SLOTS - 1)) * LOOPBACK_SLOT_SIZE + RX_FRAME_OFFSET];
+    if (likely(!raw))
+    {
+        CopyMem(io->ios2_DstAddr, &frame[0], 6);
+        CopyMem(unit->currentMacAddress, &frame[6], 6);
+        if (opener->vlanId)
+        {
+            *(UWORD *)&frame[12] = ETH_P_8021Q;
+            *(UWORD *)&frame[14] = opener->vlanId;
+        }
+        *(UWORD *)&frame[header - 2] = io->ios2_PacketType;
+    }
+    if (opener->CopyFromBuff(&frame[header], io->ios2_Data, io->ios2_DataLength) == 0)
+        goto ret_error;
+
+    ring->length[prod & (LOOPBACK_SLOTS - 1)] = header + io->ios2_DataLength;
+    ring->timestamp[prod & (LOOPBACK_SLOTS - 1)] = timer_get_us();
+    __atomic_store_n(&ring->prod_index, (UWORD)(prod + 1), __ATOMIC_RELEASE);
+    Trace(GENET_TRACE_TX_XMIT, unit->unitNumber, io->ios2_DataLength, (ULONG)io, prod);
+
+    /* Wake the unit task like a command would, it receives the frame on its next pass instead of the next poll */
+    Signal(unit->task, 1UL << unit->unit.unit_MsgPort.mp_SigBit);
+
+    unit->stats.PacketsSent++;
+    unit->internalStats.tx_packets++;
+    unit->internalStats.tx_bytes += io->ios2_DataLength;
+    unit->internalStats.tx_copy++;
+    /* ProcessCommand replies right after this */
+    LatencyRecord(&unit->latency.Tx, timer_get_us() - REQUEST_TIMESTAMP(io));
+
+    bcmgenet_tx_ring_release(unit);
+    return COMMAND_PROCESSED;
+
+ret_error:
+    Trace(GENET_TRACE_TX_DROP, unit->unitNumber, io->ios2_DataLength, (ULONG)io, (UWORD)(prod - cons));
+    unit->internalStats.tx_dropped++;
+    io->ios2_WireError = S2WERR_BUFF_ERROR;
+    io->ios2_Req.io_Error = S2ERR_NO_RESOURCES;
+    bcmgenet_tx_ring_release(unit);
+    ReportEvents(unit, S2EVENT_BUFF | S2EVENT_TX | S2EVENT_SOFTWARE | S2EVENT_ERROR);
+    return COMMAND_PROCESSED;
+}
+
+/* Unit task side, the loopback counterpart of one bcmgenet_rx_begin/next/end pass */
+UWORD LoopbackReceive(struct GenetUnit *unit, BOOL *delivered)
+{
+    struct loopback_ring *ring = &unit->lb_ring;
+    UWORD cons = ring->cons_index;
+    UWORD count = __atomic_load_n(&ring->prod_index, __ATOMIC_ACQUIRE) - cons;
+
+    for (UWORD i = 0; i < count; i++, cons++)
+    {
+        UWORD slot = cons & (LOOPBACK_SLOTS - 1);
+        unit->rx_ring.rx_frame_time = ring->timestamp[slot];
+        *delivered |= ReceiveFrame(unit, &ring->buffer[slot * LOOPBACK_SLOT_SIZE + RX_FRAME_OFFSET], ring->length[slot]);
+    }
+    __atomic_store_n(&ring->cons_index, cons, __ATOMIC_RELEASE);
+    return count;
+}
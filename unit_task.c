@@ -19,43 +19,87 @@
 
 struct Device *TimerBase = NULL;
 
-static inline BOOL ProcessReceive(struct GenetUnit *unit)
+#define STATS_INTERVAL_S 15 /* Statistics timer, also drives the expiry of long lived state */
+
+/* Take every frame covered by one producer index read, returns the number of frames */
+static inline ULONG ReceiveBatch(struct GenetUnit *unit, BOOL *delivered)
 {
+    if (unlikely(unit->loopback))
+        return LoopbackReceive(unit, delivered);
+
     UBYTE *buffer = NULL;
-    int pkt_len;
-    BOOL activity = FALSE;
+    UWORD count = bcmgenet_rx_begin(unit);
+
+    for (UWORD i = 0; i < count; i++)
+    {
+        int pkt_len = bcmgenet_rx_next(unit, &buffer);
+        if (likely(pkt_len > 0))
+            *delivered |= ReceiveFrame(unit, buffer, pkt_len);
+    }
+    if (count)
+        bcmgenet_rx_end(unit);
+    return count;
+}
+
+/* Reads filled so far are replied together, the stack wakes once per batch of at most one ring */
+static inline void ReplyReceived(struct GenetUnit *unit)
+{
+    if (unit->rx_ring.rx_done.mlh_TailPred != (struct MinNode *)&unit->rx_ring.rx_done)
+    {
+        ReplyRequestList(&unit->rx_ring.rx_done);
+        unit->internalStats.rx_reply_batches++;
+    }
+}
 
-    while (TRUE)
+/* Drain the RX ring, returns the number of frames taken from it */
+static inline ULONG ProcessReceive(struct GenetUnit *unit, BOOL *activity)
+{
+    struct GenetWakeupStats *ws = &unit->wakeups;
+    ULONG frames = 0;
+    ULONG batch;
+    BOOL delivered = FALSE;
+
+    while ((batch = ReceiveBatch(unit, &delivered)) != 0)
     {
-        pkt_len = bcmgenet_gmac_eth_recv(unit, &buffer);
-        if (pkt_len <= 0)
-            break;
-        activity |= ReceiveFrame(unit, buffer, pkt_len);
-        bcmgenet_gmac_free_pkt(unit);
+        frames += batch;
+        ReplyReceived(unit);
     }
 
-    if (activity && genetConfig.rx_poll_burst > 0)
+    if (delivered && genetConfig.rx_poll_burst > 0)
     {
         ULONG empty_streak = 0;
         ULONG iter = 0;
+        BOOL ignored = FALSE;
         while (iter < genetConfig.rx_poll_burst)
         {
-            pkt_len = bcmgenet_gmac_eth_recv(unit, &buffer);
-            if (pkt_len <= 0)
+            ws->BurstPolls++;
+            batch = ReceiveBatch(unit, &ignored);
+            if (batch == 0)
             {
+                ws->BurstEmptyPolls++;
                 if (++empty_streak >= genetConfig.rx_poll_burst_idle_break)
                     break;
             }
             else
             {
                 empty_streak = 0;
-                ReceiveFrame(unit, buffer, pkt_len);
-                bcmgenet_gmac_free_pkt(unit);
+                frames += batch;
+                ReplyReceived(unit);
             }
             iter++;
         }
     }
-    return activity;
+
+    /* Merges end with the pass */
+    GroFlushAll(unit);
+    ReplyReceived(unit);
+
+    ws->RxPasses++;
+    if (frames == 0)
+        ws->RxEmptyPasses++;
+    CountRecord(&ws->RxPerWakeup, frames);
+    *activity |= delivered;
+    return frames;
 }
 
 static void UnitTask(struct GenetUnit *unit, struct Task *parent)
@@ -111,7 +155,7 @@ static void UnitTask(struct GenetUnit *unit, struct Task *parent)
     SendIO(&packetTimerReq->tr_node);
 
     statsTimerReq->tr_node.io_Command = TR_ADDREQUEST;
-    statsTimerReq->tr_time.tv_secs = 15;
+    statsTimerReq->tr_time.tv_secs = STATS_INTERVAL_S;
     statsTimerReq->tr_time.tv_micro = 0;
     SendIO(&statsTimerReq->tr_node);
 
@@ -127,58 +171,85 @@ static void UnitTask(struct GenetUnit *unit, struct Task *parent)
                      (1UL << vblankTimerPort->mp_SigBit) |
                      SIGBREAKF_CTRL_C;
 
+    struct GenetWakeupStats *ws = &unit->wakeups;
+    _memset(ws, 0, sizeof(*ws));
+
     do
     {
         sigset = Wait(waitMask);
 
+        ULONG phaseStart = timer_get_us();
+        ULONG now;
+        ULONG rxFrames = 0;
+        ws->Wakeups++;
+
         // IO queue got a new message
         if (sigset & (1UL << unit->unit.unit_MsgPort.mp_SigBit))
         {
+            ws->Cause[GENET_WAKE_COMMAND]++;
             activity = TRUE;
             struct IOSana2Req *io;
             // Drain command queue and process it
             while ((io = (struct IOSana2Req *)GetMsg(&unit->unit.unit_MsgPort)))
             {
+                REQUEST_OWNER(io) = NULL;
                 ProcessCommand(io);
             }
+            now = timer_get_us();
+            ws->PhaseUs[GENET_PHASE_COMMAND] += now - phaseStart;
+            phaseStart = now;
         }
 
         // Opener management messages
         if (unlikely(sigset & (1UL << unit->openerPort->mp_SigBit)))
         {
+            ws->Cause[GENET_WAKE_OPENER]++;
             struct OpenerControlMsg *omsg;
             while ((omsg = (struct OpenerControlMsg *)GetMsg(unit->openerPort)))
             {
                 switch (omsg->command)
                 {
                 case OPENER_CMD_ADD:
-                    AddTailMinList(&unit->openers, (struct MinNode *)omsg->opener);
+                    UnitAddOpener(unit, omsg->opener);
                     break;
                 case OPENER_CMD_REM:
                     if (omsg->opener)
-                        RemoveMinNode((struct MinNode *)omsg->opener);
+                        UnitRemoveOpener(unit, omsg->opener);
                     break;
                 }
                 ReplyMsg(&omsg->msg);
             }
+            now = timer_get_us();
+            ws->PhaseUs[GENET_PHASE_OPENER] += now - phaseStart;
+            phaseStart = now;
         }
 
         if (unit->state == STATE_ONLINE)
         {
-            activity |= ProcessReceive(unit);
+            rxFrames = ProcessReceive(unit, &activity);
+            now = timer_get_us();
+            ws->PhaseUs[GENET_PHASE_RX] += now - phaseStart;
+            phaseStart = now;
         }
 
         // Timer expired, query PHY for link state
         if (sigset & (1UL << microHZTimerPort->mp_SigBit))
         {
+            ws->Cause[GENET_WAKE_POLL]++;
             if (CheckIO(&packetTimerReq->tr_node))
             {
                 WaitIO(&packetTimerReq->tr_node);
             }
 
             /* Periodic TX reclaim */
-            if (unit->state == STATE_ONLINE)
-                bcmgenet_tx_reclaim(unit);
+            UWORD reclaimed = 0;
+            if (unit->state == STATE_ONLINE && likely(!unit->loopback))
+            {
+                reclaimed = bcmgenet_tx_reclaim(unit);
+                CountRecord(&ws->TxPerWakeup, reclaimed);
+            }
+            if (rxFrames == 0 && reclaimed == 0)
+                ws->IdlePolls++;
 
             // TODO pool PHY for state
 
@@ -197,7 +268,7 @@ static void UnitTask(struct GenetUnit *unit, struct Task *parent)
             delay = genetConfig.poll_delay_us[backoff_idx];
 
             /* TX watchdog soft cap: ensure we never sleep beyond this while descriptors outstanding */
-            if (unit->tx_ring.free_bds < TX_DESCS && delay > genetConfig.tx_reclaim_soft_us)
+            if ((unit->tx_ring.free_bds < TX_DESCS || unit->tx_ring.tx_done_count) && delay > genetConfig.tx_reclaim_soft_us)
                 delay = genetConfig.tx_reclaim_soft_us;
 
             /* Re-arm timer */
@@ -205,30 +276,61 @@ static void UnitTask(struct GenetUnit *unit, struct Task *parent)
             packetTimerReq->tr_time.tv_secs = 0;
             packetTimerReq->tr_time.tv_micro = delay;
             SendIO(&packetTimerReq->tr_node);
+
+            now = timer_get_us();
+            ws->PhaseUs[GENET_PHASE_TX] += now - phaseStart;
+            phaseStart = now;
         }
 
         if (sigset & (1UL << vblankTimerPort->mp_SigBit))
         {
+            ws->Cause[GENET_WAKE_STATS]++;
             if(CheckIO(&statsTimerReq->tr_node))
             {
                 WaitIO(&statsTimerReq->tr_node);
             }
+            ArpExpire(unit, STATS_INTERVAL_S);
+            HoldExpireAll(unit);
             Kprintf("[genet] %s: Internal stats:\n", __func__);
             Kprintf("[genet] %s: RX packets: %ld\n", __func__, unit->internalStats.rx_packets);
             Kprintf("[genet] %s: RX bytes: %ld\n", __func__, unit->internalStats.rx_bytes);
             Kprintf("[genet] %s: RX dropped: %ld\n", __func__, unit->internalStats.rx_dropped);
             Kprintf("[genet] %s: RX ARP/IP dropped: %ld\n", __func__, unit->internalStats.rx_arp_ip_dropped);
+            Kprintf("[genet] %s: RX held: %ld, expired %ld\n", __func__, unit->internalStats.rx_held, unit->internalStats.rx_hold_expired);
+            Kprintf("[genet] %s: RX GRO merged: %ld, flushes %ld\n", __func__, unit->internalStats.rx_gro_merged, unit->internalStats.rx_gro_flushes);
+            Kprintf("[genet] %s: RX ARP answered: %ld\n", __func__, unit->internalStats.rx_arp_answered);
+            Kprintf("[genet] %s: RX limited: bcast %ld, mcast %ld, unicast %ld\n", __func__, unit->internalStats.rx_limited[RX_LIMIT_BCAST],
+                    unit->internalStats.rx_limited[RX_LIMIT_MCAST], unit->internalStats.rx_limited[RX_LIMIT_UNICAST]);
             Kprintf("[genet] %s: RX overruns: %ld\n", __func__, unit->internalStats.rx_overruns);
+            Kprintf("[genet] %s: RX reply batches: %ld\n", __func__, unit->internalStats.rx_reply_batches);
             Kprintf("[genet] %s: TX packets: %ld\n", __func__, unit->internalStats.tx_packets);
             Kprintf("[genet] %s: TX bytes: %ld\n", __func__, unit->internalStats.tx_bytes);
             Kprintf("[genet] %s: TX DMA: %ld\n", __func__, unit->internalStats.tx_dma);
             Kprintf("[genet] %s: TX copy: %ld\n", __func__, unit->internalStats.tx_copy);
             Kprintf("[genet] %s: TX dropped: %ld\n", __func__, unit->internalStats.tx_dropped);
+            Kprintf("[genet] %s: TX no buffer: %ld\n", __func__, unit->internalStats.tx_no_buffer);
+            Kprintf("[genet] %s: TX backlogged: %ld, peak %ld\n", __func__, unit->internalStats.tx_backlogged, unit->internalStats.tx_backlog_peak);
+            Kprintf("[genet] %s: TX TSO writes: %ld, segments %ld\n", __func__, unit->internalStats.tx_tso_writes, unit->internalStats.tx_tso_segments);
+            Kprintf("[genet] %s: TX reply batches: %ld\n", __func__, unit->internalStats.tx_reply_batches);
+            Kprintf("[genet] %s: RX latency: %ld samples, max %ld us\n", __func__, unit->latency.Rx.Count, unit->latency.Rx.MaxUs);
+            Kprintf("[genet] %s: TX latency: %ld samples, max %ld us\n", __func__, unit->latency.Tx.Count, unit->latency.Tx.MaxUs);
+            Kprintf("[genet] %s: Wakeups: %ld (cmd %ld, opener %ld, poll %ld, stats %ld), idle polls %ld\n", __func__,
+                    ws->Wakeups, ws->Cause[GENET_WAKE_COMMAND], ws->Cause[GENET_WAKE_OPENER],
+                    ws->Cause[GENET_WAKE_POLL], ws->Cause[GENET_WAKE_STATS], ws->IdlePolls);
+            Kprintf("[genet] %s: Pool: %ld bytes, peak %ld\n", __func__, unit->poolStats.CurrentBytes, unit->poolStats.PeakBytes);
+            for (ULONG i = 0; i < GENET_POOL_SITES; i++)
+            {
+                struct GenetPoolSiteStats *site = &unit->poolStats.Site[i];
+                Kprintf("[genet] %s: Pool site %ld: %ld bytes, peak %ld, allocs %ld, frees %ld, failures %ld\n", __func__,
+                        i, site->CurrentBytes, site->PeakBytes, site->Allocations, site->Frees, site->Failures);
+            }
 
             statsTimerReq->tr_node.io_Command = TR_ADDREQUEST;
-            statsTimerReq->tr_time.tv_secs = 15;
+            statsTimerReq->tr_time.tv_secs = STATS_INTERVAL_S;
             statsTimerReq->tr_time.tv_micro = 0;
             SendIO(&statsTimerReq->tr_node);
+
+            ws->PhaseUs[GENET_PHASE_STATS] += timer_get_us() - phaseStart;
         }
         if (sigset & SIGBREAKF_CTRL_C)
         {
@@ -288,7 +390,10 @@ int UnitTaskStart(struct GenetUnit *unit)
     *--stack = (ULONG)unit;
     task->tc_SPReg = stack;
 
-    task->tc_Node.ln_Name = "genet rx/tx";
+    _memset(unit->taskName, 0, sizeof(unit->taskName));
+    CopyMem("genet rx/tx ", unit->taskName, 12);
+    unit->taskName[12] = '0' + unit->unitNumber;
+    task->tc_Node.ln_Name = unit->taskName;
     task->tc_Node.ln_Type = NT_TASK;
     task->tc_Node.ln_Pri = genetConfig.unit_task_priority;
 